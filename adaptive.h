@@ -0,0 +1,536 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_set>
+#include <stdexcept>
+
+#include "column.h"
+#include "bitpack.h"
+#include "hash.h"
+
+// Bytes per value of a fixed width type, 0 for strings.
+inline uint64_t valueWidth(Type::type type)
+{
+    switch(type)
+    {
+    case Type::UINT8: return type_traits<Type::UINT8>::value_byte_size;
+    case Type::INT8: return type_traits<Type::INT8>::value_byte_size;
+    case Type::UINT16: return type_traits<Type::UINT16>::value_byte_size;
+    case Type::INT16: return type_traits<Type::INT16>::value_byte_size;
+    case Type::UINT32: return type_traits<Type::UINT32>::value_byte_size;
+    case Type::INT32: return type_traits<Type::INT32>::value_byte_size;
+    case Type::UINT64: return type_traits<Type::UINT64>::value_byte_size;
+    case Type::INT64: return type_traits<Type::INT64>::value_byte_size;
+    case Type::FLOAT: return type_traits<Type::FLOAT>::value_byte_size;
+    case Type::DOUBLE: return type_traits<Type::DOUBLE>::value_byte_size;
+    case Type::STRING: return 0;
+    }
+    throw std::invalid_argument("unknown type " + std::to_string(type));
+}
+
+inline bool isInteger(Type::type type)
+{
+    return type <= Type::INT64;
+}
+
+struct EncodingStats
+{
+    uint64_t rows = 0;
+    uint64_t nulls = 0;
+    uint64_t distinct = 0;
+    uint64_t runs = 0;
+    uint64_t bytes = 0;
+    // max - min of integer values.
+    uint64_t range = 0;
+};
+
+// Collects cardinality, run count and value range over a sample of a column.
+class EncodingSampler
+{
+private:
+    Type::type _type;
+    EncodingStats _stats;
+    std::unordered_set<uint64_t> _hashes;
+    uint64_t _last = 0;
+    uint64_t _min = ~uint64_t(0);
+    uint64_t _max = 0;
+public:
+    explicit EncodingSampler(Type::type type):_type(type) {}
+    inline void add(const ViewByteBuffer& value)
+    {
+        uint64_t hash = hashBytes(value._data, value._size);
+        _hashes.insert(hash);
+        _stats.runs += _stats.rows == 0 || hash != _last;
+        _last = hash;
+        _stats.rows++;
+        _stats.bytes += value._size;
+
+        if (isInteger(_type))
+        {
+            uint64_t key = orderKey(value);
+            _min = key < _min ? key : _min;
+            _max = key > _max ? key : _max;
+        }
+    }
+    // Null rows extend the current run and take no part in the other statistics.
+    inline void addNull()
+    {
+        _stats.nulls++;
+    }
+    inline EncodingStats stats() const
+    {
+        EncodingStats stats = _stats;
+        stats.distinct = _hashes.size();
+        stats.range = _stats.rows > 0 ? _max - _min : 0;
+        return stats;
+    }
+private:
+    // Maps integers of any width to unsigned keys of the same order, so max - min is the range.
+    inline uint64_t orderKey(const ViewByteBuffer& value) const
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, value._data, value._size < sizeof(bits) ? value._size : sizeof(bits));
+        uint64_t shift = 64 - 8 * value._size;
+        bool isSigned = _type == Type::INT8 || _type == Type::INT16 || _type == Type::INT32 || _type == Type::INT64;
+        if (isSigned)
+        {
+            bits = static_cast<uint64_t>(static_cast<int64_t>(bits << shift) >> shift);
+            return bits ^ (uint64_t(1) << 63);
+        }
+        return bits;
+    }
+};
+
+// Estimated bytes to hold the sampled values with an encoding, ~0 when it does not apply.
+inline uint64_t estimateSize(Type::type type, Encoding::type encoding, const EncodingStats& stats)
+{
+    uint64_t width = valueWidth(type);
+    uint64_t rows = stats.rows + stats.nulls;
+    uint64_t average = stats.rows > 0 ? stats.bytes / stats.rows : width;
+    switch(encoding)
+    {
+    case Encoding::PLAIN:
+        return width > 0 ? rows * width : stats.bytes + rows * 2 * sizeof(uint64_t);
+    case Encoding::DICTIONARY:
+    {
+        uint64_t codeWidth = stats.distinct <= 256 ? 1 : stats.distinct <= 65536 ? 2 : 4;
+        return stats.distinct * (average + 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t)) + rows * codeWidth;
+    }
+    case Encoding::RLE:
+        return stats.runs * (average + 3 * sizeof(uint64_t));
+    case Encoding::BITPACKED:
+    {
+        if (!isInteger(type))
+        {
+            return ~uint64_t(0);
+        }
+        uint64_t blocks = (rows + BitPacking::block_size - 1) / BitPacking::block_size;
+        return blocks * (BitPacking::wordCount(BitPacking::bitWidth(stats.range)) * sizeof(uint64_t) + 2 * sizeof(uint64_t) + 1);
+    }
+    default:
+        return ~uint64_t(0);
+    }
+}
+
+// The smallest of PLAIN, DICTIONARY, RLE and BITPACKED for the sample; ties go to the earlier one.
+inline Encoding::type chooseEncoding(Type::type type, const EncodingStats& stats)
+{
+    static const Encoding::type candidates[] = {Encoding::PLAIN, Encoding::DICTIONARY, Encoding::RLE, Encoding::BITPACKED};
+
+    Encoding::type best = Encoding::PLAIN;
+    uint64_t smallest = estimateSize(type, best, stats);
+    for(Encoding::type encoding : candidates)
+    {
+        uint64_t size = estimateSize(type, encoding, stats);
+        if (size < smallest)
+        {
+            best = encoding;
+            smallest = size;
+        }
+    }
+    return best;
+}
+
+// A column whose encoding is picked at runtime. The first sample_size rows of every row group are
+// held back and sampled; the group then goes to the current segment if the choice is unchanged, or
+// opens a segment with the new encoding. Rows still being sampled are served from the sample.
+class AdaptiveColumn: public Column, public IsNullable
+{
+public:
+    static constexpr uint64_t default_group_size = 64 * 1024;
+    static constexpr uint64_t default_sample_size = 4096;
+private:
+    struct Segment
+    {
+        Encoding::type encoding;
+        std::unique_ptr<Column> column;
+        IsNullable* nulls;
+    };
+
+    // Passes a segment's sections through to the writer of the whole column.
+    class SegmentWriter: public ColumnWriter
+    {
+    private:
+        ColumnWriter& _writer;
+    public:
+        explicit SegmentWriter(ColumnWriter& writer):_writer(writer) {}
+        void begin(const ColumnDescriptor&) override {}
+        void beginSection(uint64_t chunkSize) override
+        {
+            _writer.beginSection(chunkSize);
+        }
+        void write(const char* data, uint64_t size) override
+        {
+            _writer.write(data, size);
+        }
+        void endSection() override
+        {
+            _writer.endSection();
+        }
+        void end() override {}
+    };
+
+    // Reads a segment's sections from the reader of the whole column, under the segment's descriptor.
+    class SegmentReader: public ColumnReader
+    {
+    private:
+        ColumnReader& _reader;
+        ColumnDescriptor _descriptor;
+    public:
+        SegmentReader(ColumnReader& reader, const ColumnDescriptor& descriptor):_reader(reader), _descriptor(descriptor) {}
+        const ColumnDescriptor& descriptor() override
+        {
+            return _descriptor;
+        }
+        Section next() override
+        {
+            return _reader.next();
+        }
+        std::shared_ptr<const void> owner() override
+        {
+            return _reader.owner();
+        }
+    };
+
+    Type::type _type;
+    bool _nullable;
+    uint64_t _groupSize;
+    uint64_t _sampleSize;
+    Allocator* _allocator;
+    std::vector<Segment> _segments;
+    std::vector<uint64_t> _starts;
+    uint64_t _sealed = 0;
+    bool _sampling = true;
+    std::vector<char> _sample;
+    std::vector<uint64_t> _offsets{0};
+    std::vector<bool> _sampleNulls;
+public:
+    explicit AdaptiveColumn(Type::type type, bool nullable = false, uint64_t groupSize = default_group_size,
+                            uint64_t sampleSize = default_sample_size, Allocator* allocator = nullptr)
+        :_type(type), _nullable(nullable), _groupSize(groupSize), _allocator(allocator)
+    {
+        if (groupSize == 0)
+        {
+            throw std::invalid_argument("row group size must not be zero");
+        }
+        _sampleSize = sampleSize == 0 || sampleSize > groupSize ? groupSize : sampleSize;
+    }
+    void put(ByteBuffer& value) override
+    {
+        ViewByteBuffer view(value);
+        put(view);
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        if (_sampling)
+        {
+            sample(&value);
+            return;
+        }
+        _segments.back().column->put(value);
+        advance(1);
+    }
+    void putNull() override
+    {
+        if (!_nullable)
+        {
+            throw std::logic_error("putNull on a column that is not nullable");
+        }
+        if (_sampling)
+        {
+            sample(nullptr);
+            return;
+        }
+        _segments.back().nulls->putNull();
+        advance(1);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        while(count > 0)
+        {
+            if (_sampling)
+            {
+                sample(values);
+                values++;
+                count--;
+                continue;
+            }
+            uint64_t rows = remaining() < count ? remaining() : count;
+            _segments.back().column->putBatch(values, rows);
+            advance(rows);
+            values += rows;
+            count -= rows;
+        }
+    }
+    void putBatch(const char* data, uint64_t count) override
+    {
+        uint64_t width = valueWidth(_type);
+        if (width == 0)
+        {
+            return Column::putBatch(data, count);
+        }
+        while(count > 0)
+        {
+            if (_sampling)
+            {
+                ViewByteBuffer value(width, data);
+                sample(&value);
+                data += width;
+                count--;
+                continue;
+            }
+            uint64_t rows = remaining() < count ? remaining() : count;
+            _segments.back().column->putBatch(data, rows);
+            advance(rows);
+            data += rows * width;
+            count -= rows;
+        }
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        return ByteBuffer(getView(position));
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        if (position >= _sealed)
+        {
+            uint64_t row = position - _sealed;
+            return ViewByteBuffer(_offsets[row + 1] - _offsets[row], _sample.data() + _offsets[row]);
+        }
+        uint64_t index = segmentOf(position);
+        return _segments[index].column->getView(position - _starts[index]);
+    }
+    ViewByteBuffer decodeView(uint64_t position, char* buffer) override
+    {
+        if (position >= _sealed)
+        {
+            return getView(position);
+        }
+        uint64_t index = segmentOf(position);
+        return _segments[index].column->decodeView(position - _starts[index], buffer);
+    }
+    bool getNull(uint64_t position) override
+    {
+        if (position >= _sealed)
+        {
+            return _sampleNulls[position - _sealed];
+        }
+        uint64_t index = segmentOf(position);
+        return _segments[index].nulls != nullptr && _segments[index].nulls->getNull(position - _starts[index]);
+    }
+    // Encodes the rows held back for sampling, e.g. once ingest is done.
+    inline void flush()
+    {
+        if (!_sampleNulls.empty())
+        {
+            seal();
+        }
+    }
+    uint64_t size() override
+    {
+        return _sealed + _sampleNulls.size();
+    }
+    inline Type::type type()
+    {
+        return _type;
+    }
+    bool nullable() override
+    {
+        return _nullable;
+    }
+    inline uint64_t segmentCount()
+    {
+        return _segments.size();
+    }
+    inline Column& segment(uint64_t index)
+    {
+        return *_segments.at(index).column;
+    }
+    inline uint64_t segmentStart(uint64_t index)
+    {
+        return _starts.at(index);
+    }
+    inline Encoding::type segmentEncoding(uint64_t index)
+    {
+        return _segments.at(index).encoding;
+    }
+    // A section with the group size and the start row and encoding of every segment, then the
+    // sections of each segment in turn. Rows held back for sampling are encoded first.
+    void save(ColumnWriter& writer) override
+    {
+        flush();
+        writer.begin(ColumnDescriptor{static_cast<uint32_t>(_type), Encoding::ADAPTIVE, _nullable ? 1u : 0u, 0, size()});
+        std::vector<uint64_t> directory{_groupSize};
+        for(uint64_t i = 0; i < _segments.size(); ++i)
+        {
+            directory.push_back(_starts[i]);
+            directory.push_back(_segments[i].encoding);
+        }
+        writer.section(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(uint64_t));
+        SegmentWriter segments(writer);
+        for(Segment& segment : _segments)
+        {
+            segment.column->save(segments);
+        }
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        ColumnDescriptor descriptor = reader.descriptor();
+        Section section = reader.next();
+        if (section.size == 0 || section.size % (2 * sizeof(uint64_t)) != sizeof(uint64_t))
+        {
+            throw std::runtime_error("invalid segment directory");
+        }
+        std::vector<uint64_t> directory(section.size / sizeof(uint64_t));
+        memcpy(directory.data(), section.data, section.size);
+        if (directory[0] == 0)
+        {
+            throw std::runtime_error("invalid segment directory");
+        }
+
+        _type = static_cast<Type::type>(descriptor.type);
+        _nullable = descriptor.nullable != 0;
+        _groupSize = directory[0];
+        _sampleSize = _sampleSize > _groupSize ? _groupSize : _sampleSize;
+        _segments.clear();
+        _starts.clear();
+        for(uint64_t i = 1; i < directory.size(); i += 2)
+        {
+            uint64_t start = directory[i];
+            uint64_t end = i + 2 < directory.size() ? directory[i + 2] : descriptor.rows;
+            if (start != (i == 1 ? 0 : _starts.back() + _segments.back().column->size()) || end < start)
+            {
+                throw std::runtime_error("invalid segment directory");
+            }
+            Encoding::type encoding = static_cast<Encoding::type>(directory[i + 1]);
+            std::unique_ptr<Column> column = makeColumn(_type, encoding, _nullable, _allocator);
+            SegmentReader segment(reader, ColumnDescriptor{descriptor.type, encoding, descriptor.nullable, 0, end - start});
+            column->load(segment);
+            if (column->size() != end - start)
+            {
+                throw std::runtime_error("invalid segment directory");
+            }
+            IsNullable* nulls = _nullable ? dynamic_cast<IsNullable*>(column.get()) : nullptr;
+            _segments.push_back(Segment{encoding, std::move(column), nulls});
+            _starts.push_back(start);
+        }
+        if ((_segments.empty() ? 0 : _starts.back() + _segments.back().column->size()) != descriptor.rows)
+        {
+            throw std::runtime_error("invalid segment directory");
+        }
+
+        _sealed = descriptor.rows;
+        _sampling = _sealed % _groupSize == 0;
+        _sample.clear();
+        _offsets.resize(1);
+        _sampleNulls.clear();
+    }
+    uint64_t memoryUsage() override
+    {
+        uint64_t bytes = _sample.capacity() + _offsets.capacity() * sizeof(uint64_t) + _sampleNulls.capacity() / 8;
+        for(Segment& segment : _segments)
+        {
+            bytes += segment.column->memoryUsage();
+        }
+        return bytes + _segments.capacity() * sizeof(Segment) + _starts.capacity() * sizeof(uint64_t);
+    }
+private:
+    inline uint64_t remaining()
+    {
+        return _groupSize - _sealed % _groupSize;
+    }
+    inline uint64_t segmentOf(uint64_t position)
+    {
+        if (position >= _starts.back())
+        {
+            return _starts.size() - 1;
+        }
+        return static_cast<uint64_t>(std::upper_bound(_starts.begin(), _starts.end(), position) - _starts.begin()) - 1;
+    }
+    inline void advance(uint64_t rows)
+    {
+        _sealed += rows;
+        _sampling = _sealed % _groupSize == 0;
+    }
+    // Holds back one row; a null value pointer is a null row.
+    inline void sample(const ViewByteBuffer* value)
+    {
+        if (value != nullptr)
+        {
+            _sample.insert(_sample.end(), value->_data, value->_data + value->_size);
+        }
+        _offsets.push_back(_sample.size());
+        _sampleNulls.push_back(value == nullptr);
+        if (_sampleNulls.size() == _sampleSize)
+        {
+            seal();
+        }
+    }
+    inline void seal()
+    {
+        uint64_t rows = _sampleNulls.size();
+        EncodingSampler sampler(_type);
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            if (_sampleNulls[i])
+            {
+                sampler.addNull();
+                continue;
+            }
+            sampler.add(ViewByteBuffer(_offsets[i + 1] - _offsets[i], _sample.data() + _offsets[i]));
+        }
+
+        Encoding::type encoding = chooseEncoding(_type, sampler.stats());
+        if (_segments.empty() || _segments.back().encoding != encoding)
+        {
+            std::unique_ptr<Column> column = makeColumn(_type, encoding, _nullable, _allocator);
+            IsNullable* nulls = _nullable ? dynamic_cast<IsNullable*>(column.get()) : nullptr;
+            _segments.push_back(Segment{encoding, std::move(column), nulls});
+            _starts.push_back(_sealed);
+        }
+
+        Segment& segment = _segments.back();
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            if (_sampleNulls[i])
+            {
+                segment.nulls->putNull();
+                continue;
+            }
+            ViewByteBuffer value(_offsets[i + 1] - _offsets[i], _sample.data() + _offsets[i]);
+            segment.column->put(value);
+        }
+
+        _sample.clear();
+        _offsets.resize(1);
+        _sampleNulls.clear();
+        advance(rows);
+    }
+};
+
+#endif // ADAPTIVE_H
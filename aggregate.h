@@ -0,0 +1,510 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <limits>
+#include <vector>
+#include <type_traits>
+#include <memory.h>
+
+#include "types.h"
+#include "column.h"
+#include "isa.h"
+#include "bitmap.h"
+
+template<typename T>
+struct Aggregate
+{
+    typedef typename T::c_type c_type;
+    typedef typename std::conditional<std::is_floating_point<c_type>::value, double,
+            typename std::conditional<std::is_signed<c_type>::value, int64_t, uint64_t>::type>::type sum_type;
+    typedef typename std::conditional<std::is_floating_point<c_type>::value, double, uint64_t>::type accumulator_type;
+
+    uint64_t count = 0;
+    sum_type sum = 0;
+    c_type min = std::numeric_limits<c_type>::max();
+    c_type max = std::numeric_limits<c_type>::lowest();
+
+    inline double mean() const
+    {
+        return count > 0 ? static_cast<double>(sum) / count : 0;
+    }
+    inline void merge(const Aggregate<T>& ot)
+    {
+        count += ot.count;
+        sum = static_cast<sum_type>(static_cast<accumulator_type>(sum) + static_cast<accumulator_type>(ot.sum));
+        min = ot.min < min ? ot.min : min;
+        max = ot.max > max ? ot.max : max;
+    }
+};
+
+// Rows [begin, size) of data; with NULLS, bit i of validity tells whether data[i] is valid.
+template<typename T, bool NULLS>
+__attribute__((always_inline))
+inline void aggregateScalar(const typename T::c_type* data, uint64_t size, const uint64_t* validity, Aggregate<T>& out, uint64_t begin = 0)
+{
+    typedef typename T::c_type c_type;
+    typedef typename Aggregate<T>::accumulator_type accumulator_type;
+
+    accumulator_type sum = 0;
+    uint64_t count = 0;
+    c_type low = std::numeric_limits<c_type>::max();
+    c_type high = std::numeric_limits<c_type>::lowest();
+    for(uint64_t i = begin; i < size; ++i)
+    {
+        c_type value = data[i];
+        if (NULLS)
+        {
+            bool valid = (validity[i / 64] >> (i % 64)) & 1;
+            sum += valid ? static_cast<accumulator_type>(value) : 0;
+            c_type lowValue = valid ? value : low;
+            c_type highValue = valid ? value : high;
+            low = lowValue < low ? lowValue : low;
+            high = highValue > high ? highValue : high;
+            count += valid;
+        }
+        else
+        {
+            sum += static_cast<accumulator_type>(value);
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+        }
+    }
+
+    Aggregate<T> block;
+    block.count = NULLS ? count : size - begin;
+    block.sum = static_cast<typename Aggregate<T>::sum_type>(sum);
+    block.min = low;
+    block.max = high;
+
+    out.merge(block);
+}
+
+// Validity bits of a step spread over its lanes. The word holding the step's bits is broadcast, every
+// lane picks the piece of it as wide as the lane that holds its bit from within its own 128-bit half,
+// and tests that bit.
+template<typename C, int WIDTH>
+struct ValidLanes
+{
+    typedef typename std::make_unsigned<typename std::conditional<sizeof(C) == 1, int8_t,
+            typename std::conditional<sizeof(C) == 2, int16_t,
+            typename std::conditional<sizeof(C) == 4, int32_t, int64_t>::type>::type>::type>::type piece_type;
+    typedef piece_type pieces_type __attribute__((vector_size(WIDTH)));
+    typedef uint64_t words_type __attribute__((vector_size(WIDTH)));
+    typedef decltype(pieces_type() < pieces_type()) mask_type;
+
+    mask_type index;
+    pieces_type select;
+
+    __attribute__((always_inline))
+    inline ValidLanes()
+    {
+        constexpr int lanes = WIDTH / sizeof(C);
+        constexpr int bits = sizeof(C) * 8;
+        constexpr int pieces = 8 / sizeof(C);
+        constexpr int half = 16 / sizeof(C);
+        for(int lane = 0; lane < lanes; ++lane)
+        {
+            index[lane] = (lane & ~(half - 1)) + (lane / bits) % pieces;
+            select[lane] = static_cast<piece_type>(piece_type(1) << (lane % bits));
+        }
+    }
+    // Sets the lanes of the step starting at row i whose validity bit is set.
+    __attribute__((always_inline))
+    inline void operator()(const uint64_t* validity, uint64_t i, mask_type& mask) const
+    {
+        words_type words = words_type() + (validity[i / 64] >> (i % 64));
+        pieces_type source;
+        memcpy(&source, &words, WIDTH);
+        mask = (__builtin_shuffle(source, index) & select) != 0;
+    }
+};
+
+// Sums, minimums and maximums per lane. Sums widen as values are loaded, in parts that fill a register
+// once widened: integers narrower than 32 bits into 32-bit lanes that are folded into the total every
+// block of steps, before they can overflow, wider ones and floats into lanes of the accumulator. Bytes
+// widen through 16 bits, which GCC turns into sign or zero extensions where it would not from 8 to 32.
+// Null rows are masked out and counted from the validity bits.
+template<typename T, bool NULLS, int WIDTH>
+__attribute__((always_inline))
+inline void aggregateVector(const typename T::c_type* data, uint64_t size, const uint64_t* validity, Aggregate<T>& out)
+{
+    typedef typename T::c_type c_type;
+    typedef typename Aggregate<T>::accumulator_type accumulator_type;
+    constexpr bool narrow = sizeof(c_type) < 4;
+    typedef typename std::conditional<narrow, uint32_t, accumulator_type>::type lane_sum_type;
+    typedef typename std::conditional<narrow && std::is_signed<c_type>::value, int32_t, lane_sum_type>::type partial_type;
+    constexpr int lanes = WIDTH / sizeof(c_type);
+    constexpr int parts = sizeof(lane_sum_type) / sizeof(c_type);
+    constexpr int part_lanes = lanes / parts;
+    constexpr uint64_t block_steps = narrow ? uint64_t(1) << 15 : std::numeric_limits<uint64_t>::max();
+
+    typedef c_type values_type __attribute__((vector_size(WIDTH)));
+    typedef c_type part_type __attribute__((vector_size(WIDTH / parts)));
+    typedef c_type loaded_part_type __attribute__((vector_size(WIDTH / parts), aligned(1), may_alias));
+    typedef typename std::conditional<sizeof(c_type) == 1, typename std::conditional<std::is_signed<c_type>::value, int16_t, uint16_t>::type,
+            c_type>::type step_type;
+    typedef step_type steps_type __attribute__((vector_size(part_lanes * sizeof(step_type))));
+    typedef partial_type partials_type __attribute__((vector_size(WIDTH)));
+    typedef lane_sum_type sums_type __attribute__((vector_size(WIDTH)));
+    typedef typename ValidLanes<c_type, WIDTH>::mask_type mask_type;
+    typedef typename ValidLanes<c_type, WIDTH / parts>::mask_type part_mask_type;
+    const ValidLanes<c_type, WIDTH> validLanes;
+    const ValidLanes<c_type, WIDTH / parts> validPartLanes;
+
+    values_type vmin;
+    values_type vmax;
+    for(int lane = 0; lane < lanes; ++lane)
+    {
+        vmin[lane] = std::numeric_limits<c_type>::max();
+        vmax[lane] = std::numeric_limits<c_type>::lowest();
+    }
+    accumulator_type sum = 0;
+    uint64_t count = 0;
+
+    uint64_t i = 0;
+    while(i + lanes <= size)
+    {
+        sums_type vsum[parts] = {};
+        for(uint64_t step = 0; step < block_steps && i + lanes <= size; ++step, i += lanes)
+        {
+            values_type values;
+            memcpy(&values, data + i, WIDTH);
+
+            if (NULLS)
+            {
+                mask_type valid;
+                validLanes(validity, i, valid);
+                count += static_cast<uint64_t>(__builtin_popcountll(((validity[i / 64] >> (i % 64)) << (64 - lanes)) >> (64 - lanes)));
+                values_type low = valid ? values : vmin;
+                values_type high = valid ? values : vmax;
+                vmin = low < vmin ? low : vmin;
+                vmax = high > vmax ? high : vmax;
+            }
+            else
+            {
+                vmin = values < vmin ? values : vmin;
+                vmax = values > vmax ? values : vmax;
+            }
+            for(int part = 0; part < parts; ++part)
+            {
+                part_type piece = *reinterpret_cast<const loaded_part_type*>(data + i + part * part_lanes);
+                if (NULLS)
+                {
+                    part_mask_type valid;
+                    validPartLanes(validity, i + part * part_lanes, valid);
+                    piece = valid ? piece : part_type();
+                }
+                vsum[part] += (sums_type)__builtin_convertvector(__builtin_convertvector(piece, steps_type), partials_type);
+            }
+        }
+        for(int part = 0; part < parts; ++part)
+        {
+            for(int lane = 0; lane < part_lanes; ++lane)
+            {
+                sum += static_cast<accumulator_type>(static_cast<partial_type>(vsum[part][lane]));
+            }
+        }
+    }
+
+    Aggregate<T> block;
+    for(int lane = 0; lane < lanes; ++lane)
+    {
+        block.min = vmin[lane] < block.min ? vmin[lane] : block.min;
+        block.max = vmax[lane] > block.max ? vmax[lane] : block.max;
+    }
+    block.sum = static_cast<typename Aggregate<T>::sum_type>(sum);
+    block.count = NULLS ? count : i;
+
+    Aggregate<T> tail;
+    aggregateScalar<T, NULLS>(data, size, validity, tail, i);
+
+    out.merge(block);
+    out.merge(tail);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<typename T, bool NULLS>
+__attribute__((target("avx2")))
+void aggregateAvx2(const typename T::c_type* data, uint64_t size, const uint64_t* validity, Aggregate<T>& out)
+{
+    aggregateVector<T, NULLS, 32>(data, size, validity, out);
+}
+
+template<typename T, bool NULLS>
+__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl")))
+void aggregateAvx512(const typename T::c_type* data, uint64_t size, const uint64_t* validity, Aggregate<T>& out)
+{
+    aggregateVector<T, NULLS, 64>(data, size, validity, out);
+}
+#endif
+
+// validity is a bitmap with bit i set when data[i] is valid, or nullptr when all rows are.
+template<typename T>
+inline Aggregate<T> aggregate(const typename T::c_type* data, uint64_t size, const uint64_t* validity = nullptr, Isa::type isa = Isa::detect())
+{
+    Aggregate<T> out;
+
+    switch(isa)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::AVX512:
+        validity != nullptr ? aggregateAvx512<T, true>(data, size, validity, out) : aggregateAvx512<T, false>(data, size, validity, out);
+        break;
+    case Isa::AVX2:
+        validity != nullptr ? aggregateAvx2<T, true>(data, size, validity, out) : aggregateAvx2<T, false>(data, size, validity, out);
+        break;
+#endif
+    default:
+        validity != nullptr ? aggregateScalar<T, true>(data, size, validity, out) : aggregateScalar<T, false>(data, size, validity, out);
+        break;
+    }
+
+    return out;
+}
+
+template<typename T>
+inline Aggregate<T> aggregateRun(const ViewByteBuffer& value, uint64_t length)
+{
+    typedef typename Aggregate<T>::accumulator_type accumulator_type;
+
+    Aggregate<T> run;
+    if (length == 0)
+    {
+        return run;
+    }
+    typename T::c_type v;
+    memcpy(&v, value._data, sizeof(v));
+    run.count = length;
+    run.sum = static_cast<typename Aggregate<T>::sum_type>(static_cast<accumulator_type>(v) * static_cast<accumulator_type>(length));
+    run.min = v;
+    run.max = v;
+    return run;
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(TypedColumn<PlainStore, T>& column)
+{
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < column.chunkCount(); ++i)
+    {
+        ColumnChunk<T> chunk = column.chunk(i);
+        out.merge(aggregate<T>(chunk.data, chunk.size));
+    }
+    return out;
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(NullableTypedColumn<PlainStore, T>& column)
+{
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < column.chunkCount(); ++i)
+    {
+        ColumnChunk<T> chunk = column.chunk(i);
+        out.merge(aggregate<T>(chunk.data, chunk.size, column.validity().words() + chunk.offset / 64));
+    }
+    return out;
+}
+
+// Each run contributes value * length without being expanded.
+template<typename T>
+inline Aggregate<T> aggregate(TypedColumn<RleStore, T>& column)
+{
+    TypeStore<RleStore>& runs = column.store();
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < runs.runCount(); ++i)
+    {
+        out.merge(aggregateRun<T>(runs.value(i), runs.runEnd(i) - runs.runStart(i)));
+    }
+    return out;
+}
+
+// Null rows are left out by counting the valid rows of each run.
+template<typename T>
+inline Aggregate<T> aggregate(NullableTypedColumn<RleStore, T>& column)
+{
+    TypeStore<RleStore>& runs = column.store();
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < runs.runCount(); ++i)
+    {
+        out.merge(aggregateRun<T>(runs.value(i), column.validity().count(runs.runStart(i), runs.runEnd(i))));
+    }
+    return out;
+}
+
+// Blocks are decoded into a buffer that stays in L1 and aggregated from there.
+template<typename T>
+inline Aggregate<T> aggregate(TypedColumn<BitPackedStore, T>& column, Isa::type isa = Isa::detect())
+{
+    TypeStore<BitPackedStore>& store = column.store();
+    typename T::c_type values[BitPacking::block_size];
+    Aggregate<T> out;
+    for(uint64_t block = 0; block < store.blockCount(); ++block)
+    {
+        uint64_t rows = store.decode(block, values, isa);
+        out.merge(aggregate<T>(values, rows, nullptr, isa));
+    }
+    return out;
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(NullableTypedColumn<BitPackedStore, T>& column, Isa::type isa = Isa::detect())
+{
+    TypeStore<BitPackedStore>& store = column.store();
+    typename T::c_type values[BitPacking::block_size];
+    Aggregate<T> out;
+    for(uint64_t block = 0; block < store.blockCount(); ++block)
+    {
+        uint64_t rows = store.decode(block, values, isa);
+        out.merge(aggregate<T>(values, rows, column.validity().words() + block * BitPacking::block_size / 64, isa));
+    }
+    return out;
+}
+
+// Checkpoint blocks are decoded into a buffer and aggregated from there.
+inline Aggregate<Int64Type> aggregate(TypedColumn<DeltaStore, Int64Type>& column, Isa::type isa = Isa::detect())
+{
+    TypeStore<DeltaStore>& store = column.store();
+    int64_t values[TypeStore<DeltaStore>::checkpoint_interval];
+    Aggregate<Int64Type> out;
+    for(uint64_t block = 0; block < store.blockCount(); ++block)
+    {
+        uint64_t rows = store.decode(block, values);
+        out.merge(aggregate<Int64Type>(values, rows, nullptr, isa));
+    }
+    return out;
+}
+
+inline Aggregate<Int64Type> aggregate(NullableTypedColumn<DeltaStore, Int64Type>& column, Isa::type isa = Isa::detect())
+{
+    TypeStore<DeltaStore>& store = column.store();
+    int64_t values[TypeStore<DeltaStore>::checkpoint_interval];
+    Aggregate<Int64Type> out;
+    for(uint64_t block = 0; block < store.blockCount(); ++block)
+    {
+        uint64_t rows = store.decode(block, values);
+        out.merge(aggregate<Int64Type>(values, rows, column.validity().words() + block * TypeStore<DeltaStore>::checkpoint_interval / 64, isa));
+    }
+    return out;
+}
+
+// Bit i of words selects data[i]; the selection is intersected with validity a word at a time.
+template<typename T>
+inline Aggregate<T> aggregate(const typename T::c_type* data, uint64_t size, const uint64_t* validity, const uint64_t* words, Isa::type isa = Isa::detect())
+{
+    constexpr uint64_t block_size = 4096;
+
+    Aggregate<T> out;
+    uint64_t selected[block_size / 64];
+
+    for(uint64_t offset = 0; offset < size; offset += block_size)
+    {
+        uint64_t rows = size - offset < block_size ? size - offset : block_size;
+        uint64_t any = 0;
+        for(uint64_t w = 0; w < (rows + 63) / 64; ++w)
+        {
+            selected[w] = words[offset / 64 + w] & (validity != nullptr ? validity[offset / 64 + w] : ~uint64_t(0));
+            any |= selected[w];
+        }
+        if (any == 0)
+        {
+            continue;
+        }
+        out.merge(aggregate<T>(data + offset, rows, selected, isa));
+    }
+
+    return out;
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(const typename T::c_type* data, uint64_t size, const uint64_t* validity, const Bitmap& selection, Isa::type isa = Isa::detect())
+{
+    return aggregate<T>(data, size, validity, selection.words(), isa);
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(TypedColumn<PlainStore, T>& column, const Bitmap& selection)
+{
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < column.chunkCount(); ++i)
+    {
+        ColumnChunk<T> chunk = column.chunk(i);
+        out.merge(aggregate<T>(chunk.data, chunk.size, nullptr, selection.words() + chunk.offset / 64));
+    }
+    return out;
+}
+
+template<typename T>
+inline Aggregate<T> aggregate(NullableTypedColumn<PlainStore, T>& column, const Bitmap& selection)
+{
+    Aggregate<T> out;
+    for(uint64_t i = 0; i < column.chunkCount(); ++i)
+    {
+        ColumnChunk<T> chunk = column.chunk(i);
+        out.merge(aggregate<T>(chunk.data, chunk.size, column.validity().words() + chunk.offset / 64, selection.words() + chunk.offset / 64));
+    }
+    return out;
+}
+
+template<typename T, typename K>
+inline void groupByCodes(const K* codes, const typename T::c_type* data, uint64_t size, const uint64_t* validity, std::vector<Aggregate<T>>& groups)
+{
+    for(uint64_t i = 0; i < size; ++i)
+    {
+        if (validity != nullptr && ((validity[i / 64] >> (i % 64)) & 1) == 0)
+        {
+            continue;
+        }
+        Aggregate<T>& group = groups[codes[i]];
+        typename T::c_type value = data[i];
+        group.count++;
+        group.sum = static_cast<typename Aggregate<T>::sum_type>(group.sum + value);
+        group.min = value < group.min ? value : group.min;
+        group.max = value > group.max ? value : group.max;
+    }
+}
+
+// Aggregates data grouped by the dictionary codes of keys; the result is indexed by code.
+template<typename T>
+inline std::vector<Aggregate<T>> groupBy(TypeStore<DictStore>& keys, const typename T::c_type* data, uint64_t size, const uint64_t* validity = nullptr)
+{
+    std::vector<Aggregate<T>> groups(keys.cardinality());
+    size = size < keys.size() ? size : keys.size();
+
+    switch(keys.codeWidth())
+    {
+    case 1: groupByCodes<T>(reinterpret_cast<const uint8_t*>(keys.codes()), data, size, validity, groups); break;
+    case 2: groupByCodes<T>(reinterpret_cast<const uint16_t*>(keys.codes()), data, size, validity, groups); break;
+    default: groupByCodes<T>(reinterpret_cast<const uint32_t*>(keys.codes()), data, size, validity, groups); break;
+    }
+
+    return groups;
+}
+
+template<typename T>
+inline std::vector<Aggregate<T>> groupBy(TypeStore<DictStore>& keys, TypedColumn<PlainStore, T>& column)
+{
+    std::vector<Aggregate<T>> groups(keys.cardinality());
+    uint64_t width = keys.codeWidth();
+
+    for(uint64_t i = 0; i < column.chunkCount(); ++i)
+    {
+        ColumnChunk<T> chunk = column.chunk(i);
+        if (chunk.offset >= keys.size())
+        {
+            break;
+        }
+        uint64_t size = chunk.offset + chunk.size < keys.size() ? chunk.size : keys.size() - chunk.offset;
+        const char* codes = keys.codes() + chunk.offset * width;
+
+        switch(width)
+        {
+        case 1: groupByCodes<T>(reinterpret_cast<const uint8_t*>(codes), chunk.data, size, nullptr, groups); break;
+        case 2: groupByCodes<T>(reinterpret_cast<const uint16_t*>(codes), chunk.data, size, nullptr, groups); break;
+        default: groupByCodes<T>(reinterpret_cast<const uint32_t*>(codes), chunk.data, size, nullptr, groups); break;
+        }
+    }
+
+    return groups;
+}
+
+#endif // AGGREGATE_H
@@ -0,0 +1,241 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <new>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+class Allocator
+{
+public:
+    static constexpr uint64_t default_alignment = alignof(std::max_align_t);
+
+    virtual ~Allocator() {}
+    virtual char* allocate(uint64_t size, uint64_t alignment = default_alignment) = 0;
+    virtual void release(char* data, uint64_t size, uint64_t alignment = default_alignment) = 0;
+    static Allocator* heap();
+};
+
+class HeapAllocator: public Allocator
+{
+public:
+    char* allocate(uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        return static_cast<char*>(::operator new[](size, std::align_val_t(alignment)));
+    }
+    void release(char* data, uint64_t, uint64_t alignment = default_alignment) override
+    {
+        ::operator delete[](data, std::align_val_t(alignment));
+    }
+};
+
+inline Allocator* Allocator::heap()
+{
+    static HeapAllocator allocator;
+    return &allocator;
+}
+
+// Bump allocator: release() is a no-op and everything is freed at once by reset(), e.g. per batch.
+// Not thread-safe.
+class ArenaAllocator: public Allocator
+{
+private:
+    struct Block
+    {
+        char* data;
+        uint64_t size;
+    };
+
+    Allocator* _upstream;
+    uint64_t _blockSize;
+    std::vector<Block> _blocks;
+    uint64_t _current = 0;
+    uint64_t _used = 0;
+public:
+    explicit ArenaAllocator(uint64_t blockSize = 1024 * 1024, Allocator* upstream = Allocator::heap())
+        :_upstream(upstream), _blockSize(blockSize) {}
+    ArenaAllocator(const ArenaAllocator&) = delete;
+    ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+    ~ArenaAllocator()
+    {
+        for(Block& block : _blocks)
+        {
+            _upstream->release(block.data, block.size, 64);
+        }
+    }
+    char* allocate(uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        while(_current < _blocks.size())
+        {
+            uintptr_t base = reinterpret_cast<uintptr_t>(_blocks[_current].data);
+            uint64_t offset = ((base + _used + alignment - 1) & ~(alignment - 1)) - base;
+            if (offset + size <= _blocks[_current].size)
+            {
+                _used = offset + size;
+                return _blocks[_current].data + offset;
+            }
+            _current++;
+            _used = 0;
+        }
+
+        uint64_t blockSize = size + alignment > _blockSize ? size + alignment : _blockSize;
+        _blocks.push_back(Block{_upstream->allocate(blockSize, 64), blockSize});
+        _current = _blocks.size() - 1;
+        _used = 0;
+        return allocate(size, alignment);
+    }
+    void release(char*, uint64_t, uint64_t = default_alignment) override {}
+    // Makes all blocks available again without returning them upstream.
+    inline void reset()
+    {
+        _current = 0;
+        _used = 0;
+    }
+};
+
+// Size-class pool for small allocations (16 bytes to 64 KB, powers of two) carved from 1 MB slabs.
+// Larger requests go straight upstream. Not thread-safe.
+class PoolAllocator: public Allocator
+{
+private:
+    static constexpr uint64_t min_shift = 4;
+    static constexpr uint64_t max_shift = 16;
+    static constexpr uint64_t slab_size = 1024 * 1024;
+
+    Allocator* _upstream;
+    std::vector<char*> _free[max_shift - min_shift + 1];
+    std::vector<char*> _slabs;
+    uint64_t _used = slab_size;
+public:
+    explicit PoolAllocator(Allocator* upstream = Allocator::heap()):_upstream(upstream) {}
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+    ~PoolAllocator()
+    {
+        for(char* slab : _slabs)
+        {
+            _upstream->release(slab, slab_size, 64);
+        }
+    }
+    char* allocate(uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        uint64_t shift = sizeClass(size, alignment);
+        if (shift > max_shift || alignment > 64)
+        {
+            return _upstream->allocate(size, alignment);
+        }
+
+        std::vector<char*>& free = _free[shift - min_shift];
+        if (!free.empty())
+        {
+            char* data = free.back();
+            free.pop_back();
+            return data;
+        }
+
+        uint64_t bytes = uint64_t(1) << shift;
+        uint64_t align = bytes < 64 ? bytes : 64;
+        _used = (_used + align - 1) & ~(align - 1);
+        if (_used + bytes > slab_size)
+        {
+            _slabs.push_back(_upstream->allocate(slab_size, 64));
+            _used = 0;
+        }
+        char* data = _slabs.back() + _used;
+        _used += bytes;
+        return data;
+    }
+    void release(char* data, uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        uint64_t shift = sizeClass(size, alignment);
+        if (shift > max_shift || alignment > 64)
+        {
+            _upstream->release(data, size, alignment);
+            return;
+        }
+        _free[shift - min_shift].push_back(data);
+    }
+private:
+    static inline uint64_t sizeClass(uint64_t size, uint64_t alignment)
+    {
+        size = size > alignment ? size : alignment;
+        uint64_t shift = min_shift;
+        while((uint64_t(1) << shift) < size)
+        {
+            shift++;
+        }
+        return shift;
+    }
+};
+
+class MemoryLimitExceeded: public std::bad_alloc
+{
+private:
+    std::string _message;
+public:
+    MemoryLimitExceeded(uint64_t requested, uint64_t allocated, uint64_t limit)
+        :_message("memory limit exceeded: requested " + std::to_string(requested) + " bytes with "
+                  + std::to_string(allocated) + " of " + std::to_string(limit) + " in use") {}
+    const char* what() const noexcept override
+    {
+        return _message.c_str();
+    }
+};
+
+// Counts the bytes passing through to upstream and enforces an optional limit. Trackers can be
+// chained, e.g. one per column whose upstream is the tracker of the table.
+class MemoryTracker: public Allocator
+{
+private:
+    Allocator* _upstream;
+    uint64_t _limit;
+    std::atomic<uint64_t> _allocated{0};
+    std::atomic<uint64_t> _peak{0};
+public:
+    explicit MemoryTracker(Allocator* upstream = Allocator::heap(), uint64_t limit = 0)
+        :_upstream(upstream != nullptr ? upstream : Allocator::heap()), _limit(limit) {}
+    char* allocate(uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        uint64_t allocated = _allocated.fetch_add(size) + size;
+        if (_limit != 0 && allocated > _limit)
+        {
+            _allocated.fetch_sub(size);
+            throw MemoryLimitExceeded(size, allocated - size, _limit);
+        }
+
+        char* data = nullptr;
+        try {
+            data = _upstream->allocate(size, alignment);
+        } catch(...)
+        {
+            _allocated.fetch_sub(size);
+            throw;
+        }
+
+        uint64_t peak = _peak.load();
+        while(allocated > peak && !_peak.compare_exchange_weak(peak, allocated));
+        return data;
+    }
+    void release(char* data, uint64_t size, uint64_t alignment = default_alignment) override
+    {
+        _upstream->release(data, size, alignment);
+        _allocated.fetch_sub(size);
+    }
+    inline uint64_t allocated() const
+    {
+        return _allocated.load();
+    }
+    inline uint64_t peak() const
+    {
+        return _peak.load();
+    }
+    inline uint64_t limit() const
+    {
+        return _limit;
+    }
+};
+
+#endif // ALLOCATOR_H
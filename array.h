@@ -3,35 +3,122 @@
 
 #include <memory>
 #include <memory.h>
+#include <new>
+#include <vector>
+#include <stdexcept>
+#include <sys/mman.h>
 
+#include "allocator.h"
+
+struct ArrayChunk
+{
+    const char* data;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Append-only storage made of fixed-size chunks. Nothing is relocated on growth; an offset
+// addresses byte (offset % chunkSize) of chunk (offset / chunkSize).
 class Array
 {
+public:
+    static constexpr uint64_t alignment = 64;
+    static constexpr uint64_t default_chunk_size = 4 * 1024 * 1024;
+    static constexpr uint64_t huge_page_size = 2 * 1024 * 1024;
 private:
-    char* _data = nullptr;
-    uint64_t _capacity = 0;
+    struct Block
+    {
+        char* data;
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    Allocator* _allocator;
+    std::vector<char*> _chunks;
+    std::vector<Block> _blocks;
+    uint64_t _chunkSize;
+    uint64_t _shift;
     uint64_t _size = 0;
+    bool _hugePages;
+    bool _readOnly = false;
 public:
-    Array()
+    explicit Array(uint64_t chunkSize = default_chunk_size, bool hugePages = false, Allocator* allocator = Allocator::heap())
+        :_allocator(allocator != nullptr ? allocator : Allocator::heap()), _chunkSize(chunkSize), _shift(0), _hugePages(hugePages)
     {
-        _data = new char[1024*1024];
-        _capacity = 1024*1024;
-        _size = 0;
+        setChunkSize(chunkSize);
     }
-    inline void emplace_back(uint64_t size, const char* data)
+    Array(const Array&) = delete;
+    Array& operator=(const Array&) = delete;
+    // Appends data so that it stays contiguous in memory and returns its offset.
+    inline uint64_t emplace_back(uint64_t size, const char* data)
     {
-        uint64_t bytesLeft = _capacity - _size;
-
-        if (bytesLeft < size)
+        uint64_t offset = reserve(size);
+        if (size > 0)
         {
-            resize();
+            memcpy(get(offset), data, size);
         }
-
-        memcpy(&_data[_size], data, size);
-        _size += size;
+        _size = offset + size;
+        return offset;
+    }
+    // Appends data that may be split across chunks, such as a batch of fixed-width values.
+    inline uint64_t append(uint64_t size, const char* data)
+    {
+        checkWritable();
+        uint64_t offset = _size;
+        while(size > 0)
+        {
+            if (_size == capacity())
+            {
+                grow(1);
+            }
+            uint64_t room = capacity() - _size;
+            uint64_t bytes = size < room ? size : room;
+            memcpy(get(_size), data, bytes);
+            _size += bytes;
+            data += bytes;
+            size -= bytes;
+        }
+        return offset;
+    }
+    // Makes room for size contiguous bytes, skipping to the next chunk when they would straddle one.
+    // The skipped tail is zeroed, as it is saved along with the chunk.
+    inline uint64_t reserve(uint64_t size)
+    {
+        checkWritable();
+        if (capacity() - _size >= size)
+        {
+            return _size;
+        }
+        uint64_t offset = capacity();
+        if (_size < offset)
+        {
+            memset(get(_size), 0, offset - _size);
+        }
+        grow((size + _chunkSize - 1) >> _shift);
+        _size = offset;
+        return offset;
     }
     inline char* get(uint64_t offset)
     {
-        return &_data[offset];
+        return _chunks[offset >> _shift] + (offset & (_chunkSize - 1));
+    }
+    inline char* get(uint64_t chunk, uint64_t offset)
+    {
+        return _chunks[chunk] + offset;
+    }
+    inline uint64_t chunkCount()
+    {
+        return (_size + _chunkSize - 1) >> _shift;
+    }
+    inline ArrayChunk chunk(uint64_t index)
+    {
+        uint64_t start = index << _shift;
+        uint64_t size = _size - start < _chunkSize ? _size - start : _chunkSize;
+        return ArrayChunk{static_cast<const char*>(__builtin_assume_aligned(_chunks[index], alignment)), start, size};
+    }
+    inline uint64_t chunkSize()
+    {
+        return _chunkSize;
     }
     inline uint64_t size()
     {
@@ -39,27 +126,164 @@ public:
     }
     inline uint64_t capacity()
     {
-        return _capacity;
+        return _chunks.size() << _shift;
+    }
+    inline Allocator* allocator()
+    {
+        return _allocator;
+    }
+    // Serves size bytes laid out with the given chunk size from memory owned elsewhere, e.g. a
+    // file mapping. The array becomes read-only.
+    inline void map(const char* data, uint64_t size, uint64_t chunkSize)
+    {
+        if (!_chunks.empty())
+        {
+            throw std::logic_error("cannot map into a non-empty array");
+        }
+        setChunkSize(chunkSize);
+        for(uint64_t offset = 0; offset < size; offset += chunkSize)
+        {
+            _chunks.push_back(const_cast<char*>(data) + offset);
+        }
+        _size = size;
+        _readOnly = true;
+    }
+    inline bool readOnly()
+    {
+        return _readOnly;
     }
     ~Array()
     {
-        delete[] _data;
-        _data = nullptr;
-        _capacity = 0;
+        for(Block& block : _blocks)
+        {
+            _allocator->release(block.data, block.size, block.alignment);
+        }
+        _blocks.clear();
+        _chunks.clear();
         _size = 0;
     }
 private:
-    inline void resize()
+    inline void setChunkSize(uint64_t chunkSize)
     {
-        uint64_t newCapacity = _capacity * 2;
-        char* newData = new char[newCapacity];
-        memcpy(newData, _data, _size);
-
-        delete[] _data;
-        _data = nullptr;
+        if (chunkSize < 4096 || (chunkSize & (chunkSize - 1)) != 0)
+        {
+            throw std::invalid_argument("chunk size must be a power of two of at least 4096");
+        }
+        _chunkSize = chunkSize;
+        _shift = 0;
+        while((uint64_t(1) << _shift) < chunkSize)
+        {
+            _shift++;
+        }
+    }
+    inline void checkWritable()
+    {
+        if (_readOnly)
+        {
+            throw std::logic_error("array is mapped read-only");
+        }
+    }
+    // Values larger than a chunk get one block spanning several chunk slots, so they stay contiguous.
+    inline void grow(uint64_t chunks)
+    {
+        chunks = chunks > 0 ? chunks : 1;
+        uint64_t size = chunks << _shift;
+        uint64_t align = _hugePages && size >= huge_page_size ? huge_page_size : alignment;
+        char* block = _allocator->allocate(size, align);
+#ifdef MADV_HUGEPAGE
+        if (align == huge_page_size)
+        {
+            madvise(block, size, MADV_HUGEPAGE);
+        }
+#endif
+        _blocks.push_back(Block{block, size, align});
+        for(uint64_t i = 0; i < chunks; ++i)
+        {
+            _chunks.push_back(block + (i << _shift));
+        }
+    }
+};
 
-        _data = newData;
-        _capacity = newCapacity;
+// A std::vector that can instead borrow read-only memory owned elsewhere, e.g. a file mapping.
+template<typename T>
+class MappableVector
+{
+private:
+    std::vector<T> _owned;
+    const T* _borrowed = nullptr;
+    uint64_t _size = 0;
+    bool _mapped = false;
+public:
+    inline void push_back(const T& value)
+    {
+        checkWritable();
+        _owned.push_back(value);
+    }
+    inline void resize(uint64_t size, const T& value = T())
+    {
+        checkWritable();
+        _owned.resize(size, value);
+    }
+    inline void swap(std::vector<T>& values)
+    {
+        checkWritable();
+        _owned.swap(values);
+    }
+    inline const T& operator[](uint64_t index) const
+    {
+        return _mapped ? _borrowed[index] : _owned[index];
+    }
+    inline T& operator[](uint64_t index)
+    {
+        return _mapped ? const_cast<T&>(_borrowed[index]) : _owned[index];
+    }
+    inline const T& at(uint64_t index) const
+    {
+        if (index >= size())
+        {
+            throw std::out_of_range("MappableVector::at");
+        }
+        return (*this)[index];
+    }
+    inline const T* data() const
+    {
+        return _mapped ? _borrowed : _owned.data();
+    }
+    inline T* data()
+    {
+        return _mapped ? const_cast<T*>(_borrowed) : _owned.data();
+    }
+    inline uint64_t size() const
+    {
+        return _mapped ? _size : _owned.size();
+    }
+    inline bool empty() const
+    {
+        return size() == 0;
+    }
+    inline bool mapped() const
+    {
+        return _mapped;
+    }
+    // Heap bytes held; borrowed memory is not counted.
+    inline uint64_t capacity() const
+    {
+        return _owned.capacity();
+    }
+    inline void map(const T* data, uint64_t size)
+    {
+        std::vector<T>().swap(_owned);
+        _borrowed = data;
+        _size = size;
+        _mapped = true;
+    }
+private:
+    inline void checkWritable()
+    {
+        if (_mapped)
+        {
+            throw std::logic_error("vector is mapped read-only");
+        }
     }
 };
 
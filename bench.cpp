@@ -0,0 +1,735 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+#include "column.h"
+#include "operators.h"
+#include "csv.h"
+#include "ingest.h"
+#include "aggregate.h"
+#include "filter.h"
+#include "groupby.h"
+#include "join.h"
+#include "sort.h"
+#include "topk.h"
+#include "table.h"
+#include "columnfile.h"
+#include "benchmark.h"
+
+using namespace std;
+
+static vector<ViewByteBuffer> views(const vector<string>& values)
+{
+    vector<ViewByteBuffer> out;
+    out.reserve(values.size());
+    for(const string& value : values)
+    {
+        out.emplace_back(value.size(), value.data());
+    }
+    return out;
+}
+
+static uint64_t bytes(const vector<string>& values)
+{
+    uint64_t total = 0;
+    for(const string& value : values)
+    {
+        total += value.size();
+    }
+    return total;
+}
+
+template<typename T>
+static void benchFromString(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<string> text = generator.text<T>();
+    vector<ViewByteBuffer> cells = views(text);
+    FromStringCast<T> cast;
+
+    runner.run(string("from_string/") + T::name, cells.size(), bytes(text), [&]() {
+        for(ViewByteBuffer& cell : cells)
+        {
+            ByteBuffer value = cast.operation(cell);
+            doNotOptimize(value._data);
+        }
+    });
+
+    vector<char> out(cells.size() * sizeof(typename T::c_type));
+    runner.run(string("from_string_batch/") + T::name, cells.size(), bytes(text), [&]() {
+        uint64_t done = 0;
+        cast.parse(cells.data(), cells.size(), out.data(), done);
+        doNotOptimize(out.data());
+    });
+}
+
+template<typename T>
+static void benchToString(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<typename T::c_type> values = generator.numbers<T>();
+    ToStringCast<T> cast;
+
+    runner.run(string("to_string/") + T::name, values.size(), values.size() * sizeof(typename T::c_type), [&]() {
+        for(typename T::c_type& value : values)
+        {
+            ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+            ByteBuffer text = cast.operation(view);
+            doNotOptimize(text._data);
+        }
+    });
+}
+
+static void benchStringCasts(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<string> names = generator.strings();
+    vector<ViewByteBuffer> cells = views(names);
+    FromStringCast<StringType> from;
+    ToStringCast<StringType> to;
+
+    runner.run("from_string/STRING", cells.size(), bytes(names), [&]() {
+        for(ViewByteBuffer& cell : cells)
+        {
+            ByteBuffer value = from.operation(cell);
+            doNotOptimize(value._data);
+        }
+    });
+
+    runner.run("to_string/STRING", cells.size(), bytes(names), [&]() {
+        for(ViewByteBuffer& cell : cells)
+        {
+            ByteBuffer value = to.operation(cell);
+            doNotOptimize(value._data);
+        }
+    });
+}
+
+static void benchSplit(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<string> names = generator.strings();
+    vector<string> numbers = generator.text<Int64Type>();
+    vector<string> lines(names.size());
+    for(uint64_t i = 0; i < lines.size(); ++i)
+    {
+        lines[i] = numbers[i] + "," + names[i] + "," + numbers[(i + 1) % lines.size()] + "," + names[(i + 1) % lines.size()];
+    }
+
+    vector<experimental::string_view> fields;
+    runner.run("split", lines.size(), bytes(lines), [&]() {
+        for(const string& line : lines)
+        {
+            fields.clear();
+            split(fields, line, ',');
+            doNotOptimize(fields.data());
+        }
+    });
+}
+
+static void benchArray(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<string> names = generator.strings();
+
+    runner.run("array_emplace_back/INT64", numbers.size(), numbers.size() * sizeof(int64_t), [&]() {
+        Array array;
+        for(int64_t& value : numbers)
+        {
+            array.emplace_back(sizeof(value), reinterpret_cast<char*>(&value));
+        }
+        doNotOptimize(array.size());
+    });
+
+    runner.run("array_emplace_back/STRING", names.size(), bytes(names), [&]() {
+        Array array;
+        for(const string& value : names)
+        {
+            array.emplace_back(value.size(), value.data());
+        }
+        doNotOptimize(array.size());
+    });
+}
+
+static void benchStores(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<string> names = generator.strings();
+    vector<ViewByteBuffer> cells = views(names);
+
+    runner.run("plain_store_put/INT64", numbers.size(), numbers.size() * sizeof(int64_t), [&]() {
+        TypeStore<PlainStore> store;
+        for(int64_t& value : numbers)
+        {
+            ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+            store.put(view);
+        }
+        doNotOptimize(store.size());
+    });
+
+    TypeStore<PlainStore> plain;
+    for(int64_t& value : numbers)
+    {
+        ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+        plain.put(view);
+    }
+    runner.run("plain_store_get/INT64", numbers.size(), numbers.size() * sizeof(int64_t), [&]() {
+        for(uint64_t i = 0; i < numbers.size(); ++i)
+        {
+            ViewByteBuffer value = plain.getView(i * sizeof(int64_t), sizeof(int64_t));
+            doNotOptimize(value._data);
+        }
+    });
+
+    runner.run("dict_store_put/STRING", cells.size(), bytes(names), [&]() {
+        TypeStore<DictStore> store;
+        for(ViewByteBuffer& cell : cells)
+        {
+            store.put(cell);
+        }
+        doNotOptimize(store.codes());
+    });
+
+    TypeStore<DictStore> dictionary;
+    for(ViewByteBuffer& cell : cells)
+    {
+        dictionary.put(cell);
+    }
+    runner.run("dict_store_get/STRING", cells.size(), bytes(names), [&]() {
+        for(uint64_t i = 0; i < cells.size(); ++i)
+        {
+            ViewByteBuffer value = dictionary.getView(i, sizeof(ByteBuffer));
+            doNotOptimize(value._data);
+        }
+    });
+}
+
+static void benchScans(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<double> reals = generator.numbers<DoubleType>();
+    vector<int32_t> integers = generator.numbers<Int32Type>();
+    vector<char> nulls = generator.nulls();
+    vector<string> names = generator.strings();
+    uint64_t rows = numbers.size();
+
+    TypedColumn<PlainStore, Int64Type> column;
+    column.putBatch(reinterpret_cast<char*>(numbers.data()), rows);
+    NullableTypedColumn<PlainStore, DoubleType> nullable;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        if (nulls[i] != 0)
+        {
+            nullable.putNull();
+            continue;
+        }
+        ViewByteBuffer value(sizeof(double), reinterpret_cast<char*>(&reals[i]));
+        nullable.put(value);
+    }
+    TypedColumn<PlainStore, Int32Type> filtered;
+    filtered.putBatch(reinterpret_cast<char*>(integers.data()), rows);
+    TypedColumn<DictStore, StringType> dictionary;
+    for(const string& name : names)
+    {
+        ViewByteBuffer view(name.size(), name.data());
+        dictionary.put(view);
+    }
+
+    runner.run("scan_get_view/INT64", rows, rows * sizeof(int64_t), [&]() {
+        Column& base = column;
+        int64_t sum = 0;
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            ViewByteBuffer value = base.getView(i);
+            sum += *reinterpret_cast<int64_t*>(value._data);
+        }
+        doNotOptimize(sum);
+    });
+
+    runner.run("scan_aggregate/INT64", rows, rows * sizeof(int64_t), [&]() {
+        Aggregate<Int64Type> result = aggregate(column);
+        doNotOptimize(result.sum);
+    });
+
+    runner.run("scan_aggregate_nullable/DOUBLE", rows, rows * sizeof(double) + rows / 8, [&]() {
+        Aggregate<DoubleType> result = aggregate(nullable);
+        doNotOptimize(result.sum);
+    });
+
+    int32_t pivot = integers[rows / 2];
+    Bitmap selection;
+    ColumnPredicate<Int32Type> predicate(filtered, CompareOp::LT, {pivot});
+    runner.run("scan_filter_lt/INT32", rows, rows * sizeof(int32_t), [&]() {
+        predicate.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    vector<int64_t> timestamps(rows);
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        timestamps[i] = 1600000000000LL + static_cast<int64_t>(i) * 1000;
+    }
+    TypedColumn<PlainStore, Int64Type> sorted;
+    sorted.putBatch(reinterpret_cast<char*>(timestamps.data()), rows);
+    ColumnPredicate<Int64Type> range(sorted, CompareOp::BETWEEN, {timestamps[rows / 2], timestamps[rows / 2 + rows / 20]});
+    runner.run("scan_filter_range_sorted/INT64", rows, rows * sizeof(int64_t), [&]() {
+        range.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    TypedColumn<RleStore, Int32Type> runs;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        int32_t value = integers[i / 1024];
+        ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+        runs.put(view);
+    }
+    runner.run("scan_aggregate_rle/INT32", rows, runs.memoryUsage(), [&]() {
+        Aggregate<Int32Type> result = aggregate(runs);
+        doNotOptimize(result.sum);
+    });
+    RunPredicate<Int32Type> runsBelow(runs, CompareOp::LT, {pivot});
+    runner.run("scan_filter_lt_rle/INT32", rows, runs.memoryUsage(), [&]() {
+        runsBelow.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    TypedColumn<BitPackedStore, Int64Type> packed;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        int64_t value = numbers[i] & 0xffff;
+        ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+        packed.put(view);
+    }
+    runner.run("scan_aggregate_bitpacked/INT64", rows, packed.memoryUsage(), [&]() {
+        Aggregate<Int64Type> result = aggregate(packed);
+        doNotOptimize(result.sum);
+    });
+    PackedPredicate<Int64Type> packedBelow(packed, CompareOp::LT, {0x8000});
+    runner.run("scan_filter_lt_bitpacked/INT64", rows, packed.memoryUsage(), [&]() {
+        packedBelow.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    TypedColumn<DeltaStore, Int64Type> deltas;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        ViewByteBuffer view(sizeof(int64_t), reinterpret_cast<char*>(&timestamps[i]));
+        deltas.put(view);
+    }
+    runner.run("scan_aggregate_delta/INT64", rows, deltas.memoryUsage(), [&]() {
+        Aggregate<Int64Type> result = aggregate(deltas);
+        doNotOptimize(result.sum);
+    });
+    DeltaPredicate<> deltaRange(deltas, CompareOp::BETWEEN, {timestamps[rows / 2], timestamps[rows / 2 + rows / 20]});
+    runner.run("scan_filter_range_delta/INT64", rows, deltas.memoryUsage(), [&]() {
+        deltaRange.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    TypedColumn<PlainStore, StringType> text;
+    TypedColumn<CompressedStore, StringType> compressed;
+    for(const string& name : names)
+    {
+        ViewByteBuffer view(name.size(), name.data());
+        text.put(view);
+        compressed.put(view);
+    }
+    runner.run("scan_get_view/STRING", rows, text.memoryUsage(), [&]() {
+        uint64_t length = 0;
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            length += text.getView(i)._size;
+        }
+        doNotOptimize(length);
+    });
+    runner.run("scan_get_view_lz4/STRING", rows, compressed.memoryUsage(), [&]() {
+        uint64_t length = 0;
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            length += compressed.getView(i)._size;
+        }
+        doNotOptimize(length);
+    });
+
+    DictionaryPredicate<> equals(dictionary, CompareOp::EQ, {names[rows / 2]});
+    runner.run("scan_filter_eq/DICT_STRING", rows, rows * dictionary.dictionary().codeWidth(), [&]() {
+        equals.evaluate(selection);
+        doNotOptimize(selection.words());
+    });
+
+    runner.run("scan_group_by/DICT_STRING", rows, rows * sizeof(int64_t), [&]() {
+        vector<Aggregate<Int64Type>> groups = groupBy<Int64Type>(dictionary.dictionary(), column);
+        doNotOptimize(groups.data());
+    });
+
+    HashGroupBy<Int64Type> byName;
+    byName.key(dictionary);
+    byName.value(column);
+    runner.run("group_by_parallel/DICT_STRING", rows, rows * sizeof(int64_t), [&]() {
+        GroupByResult<Int64Type> groups = byName.run();
+        doNotOptimize(groups.rows.data());
+    });
+    TypedColumn<PlainStore, Int32Type> days;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        int32_t day = static_cast<int32_t>(static_cast<uint32_t>(integers[i]) % 31);
+        ViewByteBuffer view(sizeof(day), reinterpret_cast<char*>(&day));
+        days.put(view);
+    }
+    HashGroupBy<Int64Type> byNameAndDay;
+    byNameAndDay.key(dictionary);
+    byNameAndDay.key(days);
+    byNameAndDay.value(column);
+    runner.run("group_by_parallel_hash/DICT_STRING,INT32", rows, rows * (sizeof(int64_t) + sizeof(int32_t)), [&]() {
+        GroupByResult<Int64Type> groups = byNameAndDay.run();
+        doNotOptimize(groups.rows.data());
+    });
+}
+
+static void benchJoin(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int32_t> integers = generator.numbers<Int32Type>();
+    uint64_t rows = integers.size();
+    uint64_t dimensions = rows / 16 > 0 ? rows / 16 : 1;
+
+    TypedColumn<PlainStore, Int64Type> events;
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        int64_t id = static_cast<int64_t>(static_cast<uint32_t>(integers[i]) % (dimensions * 2));
+        ViewByteBuffer view(sizeof(id), reinterpret_cast<char*>(&id));
+        events.put(view);
+    }
+    TypedColumn<PlainStore, Int64Type> ids;
+    for(uint64_t i = 0; i < dimensions; ++i)
+    {
+        int64_t id = static_cast<int64_t>(i * 2);
+        ViewByteBuffer view(sizeof(id), reinterpret_cast<char*>(&id));
+        ids.put(view);
+    }
+
+    HashJoin inner(JoinType::INNER);
+    inner.left().key(events);
+    inner.right().key(ids);
+    runner.run("join_hash_inner/INT64", rows, (rows + dimensions) * sizeof(int64_t), [&]() {
+        JoinResult pairs = inner.run();
+        doNotOptimize(pairs.left.data());
+    });
+    HashJoin left(JoinType::LEFT);
+    left.left().key(events);
+    left.right().key(ids);
+    runner.run("join_hash_left/INT64", rows, (rows + dimensions) * sizeof(int64_t), [&]() {
+        JoinResult pairs = left.run();
+        doNotOptimize(pairs.left.data());
+    });
+}
+
+static void benchSort(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<string> names = generator.strings();
+    uint64_t rows = numbers.size();
+
+    TypedColumn<PlainStore, Int64Type> column;
+    column.putBatch(reinterpret_cast<char*>(numbers.data()), rows);
+    TypedColumn<PlainStore, StringType> text;
+    TypedColumn<DictStore, StringType> dictionary;
+    for(const string& name : names)
+    {
+        ViewByteBuffer view(name.size(), name.data());
+        text.put(view);
+        dictionary.put(view);
+    }
+
+    runner.run("sort_radix/INT64", rows, rows * sizeof(int64_t), [&]() {
+        TypedColumn<PlainStore, Int64Type> sorted;
+        sort(column, sorted);
+        doNotOptimize(sorted.size());
+    });
+    runner.run("argsort_radix/INT64", rows, rows * sizeof(int64_t), [&]() {
+        vector<uint64_t> order = argsort(column);
+        doNotOptimize(order.data());
+    });
+    runner.run("argsort_prefix/STRING", rows, text.memoryUsage(), [&]() {
+        vector<uint64_t> order = argsort(text);
+        doNotOptimize(order.data());
+    });
+    runner.run("order_by/DICT_STRING,INT64", rows, rows * sizeof(int64_t), [&]() {
+        OrderBy orderBy;
+        orderBy.key(dictionary);
+        orderBy.key(column, SortOrder::DESCENDING);
+        vector<uint64_t> order = orderBy.run();
+        doNotOptimize(order.data());
+    });
+    runner.run("top_k_100/INT64", rows, rows * sizeof(int64_t), [&]() {
+        vector<uint64_t> top = topK(column, 100);
+        doNotOptimize(top.data());
+    });
+    runner.run("top_k_100/STRING", rows, text.memoryUsage(), [&]() {
+        vector<uint64_t> top = topK(text, 100);
+        doNotOptimize(top.data());
+    });
+}
+
+static void benchTable(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<double> reals = generator.numbers<DoubleType>();
+    vector<char> nulls = generator.nulls();
+    vector<string> names = generator.strings();
+    uint64_t rows = numbers.size();
+
+    Table table(Schema{
+        {"id", Type::INT64, Encoding::PLAIN, false},
+        {"value", Type::DOUBLE, Encoding::PLAIN, true},
+        {"name", Type::STRING, Encoding::DICTIONARY, false}
+    });
+    table.column(0).putBatch(reinterpret_cast<char*>(numbers.data()), rows);
+    IsNullable& values = dynamic_cast<IsNullable&>(table.column(1));
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        if (nulls[i] != 0)
+        {
+            values.putNull();
+        }
+        else
+        {
+            ViewByteBuffer value(sizeof(double), reinterpret_cast<char*>(&reals[i]));
+            table.column(1).put(value);
+        }
+        ViewByteBuffer name(names[i].size(), names[i].data());
+        table.column(2).put(name);
+    }
+
+    runner.run("table_scan/INT64,DOUBLE", rows, rows * (sizeof(int64_t) + sizeof(double)), [&]() {
+        TableScanner scanner = table.scan(Table::default_batch_size, {"id", "value"});
+        Batch batch;
+        double sum = 0;
+        while(scanner.next(batch))
+        {
+            const int64_t* ids = batch.columns[0].data<Int64Type>();
+            const double* data = batch.columns[1].data<DoubleType>();
+            for(uint64_t i = 0; i < batch.size; ++i)
+            {
+                sum += batch.columns[1].isNull(i) ? 0 : data[i] * static_cast<double>(ids[i] & 1);
+            }
+        }
+        doNotOptimize(sum);
+    });
+    runner.run("table_scan/DICT_STRING", rows, table.column(2).memoryUsage(), [&]() {
+        TableScanner scanner = table.scan(Table::default_batch_size, {"name"});
+        Batch batch;
+        uint64_t length = 0;
+        while(scanner.next(batch))
+        {
+            for(uint64_t i = 0; i < batch.size; ++i)
+            {
+                length += batch.columns[0].views[i]._size;
+            }
+        }
+        doNotOptimize(length);
+    });
+
+    // Rows of some 400 bytes put a batch of compressed strings across more pages than the page cache
+    // holds, so every view of a batch has to outlive the pages it came from.
+    uint64_t textRows = rows < 64 * 1024 ? rows : 64 * 1024;
+    vector<string> texts(textRows);
+    Table compressed(Schema{
+        {"text", Type::STRING, Encoding::COMPRESSED, false}
+    });
+    for(uint64_t i = 0; i < textRows; ++i)
+    {
+        texts[i] = to_string(i);
+        while(texts[i].size() < 400)
+        {
+            texts[i] += names[(i + texts[i].size()) % rows];
+        }
+        ViewByteBuffer text(texts[i].size(), texts[i].data());
+        compressed.column(0).put(text);
+    }
+    {
+        TableScanner scanner = compressed.scan();
+        Batch batch;
+        while(scanner.next(batch))
+        {
+            for(uint64_t i = 0; i < batch.size; ++i)
+            {
+                const ViewByteBuffer& text = batch.columns[0].views[i];
+                if (string(text._data, text._size) != texts[batch.offset + i])
+                {
+                    throw runtime_error("compressed strings do not survive a table scan");
+                }
+            }
+        }
+    }
+    runner.run("table_scan/COMPRESSED_STRING", textRows, bytes(texts), [&]() {
+        TableScanner scanner = compressed.scan();
+        Batch batch;
+        uint64_t length = 0;
+        while(scanner.next(batch))
+        {
+            for(uint64_t i = 0; i < batch.size; ++i)
+            {
+                length += batch.columns[0].views[i]._size;
+            }
+        }
+        doNotOptimize(length);
+    });
+}
+
+static void benchColumnFile(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<int64_t> numbers = generator.numbers<Int64Type>();
+    vector<char> nulls = generator.nulls();
+    vector<string> names = generator.strings();
+    uint64_t rows = numbers.size();
+
+    Table table(Schema{
+        {"id", Type::INT64, Encoding::ADAPTIVE, true},
+        {"name", Type::STRING, Encoding::ADAPTIVE, false}
+    });
+    IsNullable& ids = dynamic_cast<IsNullable&>(table.column(0));
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        if (nulls[i] != 0)
+        {
+            ids.putNull();
+        }
+        else
+        {
+            ViewByteBuffer id(sizeof(int64_t), reinterpret_cast<char*>(&numbers[i]));
+            table.column(0).put(id);
+        }
+        ViewByteBuffer name(names[i].size(), names[i].data());
+        table.column(1).put(name);
+    }
+
+    char path[] = "/tmp/column_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        throw runtime_error("cannot create temporary file");
+    }
+    close(fd);
+    saveColumns(path, table.columns());
+
+    // The loaded columns must read back row for row before their load time means anything.
+    vector<unique_ptr<Column>> columns = loadColumns(path, true);
+    bool same = columns.size() == 2 && columns[0]->size() == rows && columns[1]->size() == rows;
+    IsNullable* loaded = same ? dynamic_cast<IsNullable*>(columns[0].get()) : nullptr;
+    same = loaded != nullptr;
+    for(uint64_t i = 0; same && i < rows; ++i)
+    {
+        ViewByteBuffer name = columns[1]->getView(i);
+        same = loaded->getNull(i) == (nulls[i] != 0) && string(name._data, name._size) == names[i];
+        if (same && nulls[i] == 0)
+        {
+            int64_t id;
+            memcpy(&id, columns[0]->getView(i)._data, sizeof(id));
+            same = id == numbers[i];
+        }
+    }
+    if (!same)
+    {
+        remove(path);
+        throw runtime_error("adaptive columns do not survive a column file round trip");
+    }
+
+    uint64_t size = table.column(0).memoryUsage() + table.column(1).memoryUsage();
+    runner.run("column_file_load/ADAPTIVE", rows, size, [&]() {
+        vector<unique_ptr<Column>> columns = loadColumns(path);
+        doNotOptimize(columns.data());
+    });
+
+    remove(path);
+}
+
+static void benchIngest(BenchmarkRunner& runner, DataGenerator& generator)
+{
+    vector<string> numbers = generator.text<Int64Type>();
+    vector<string> reals = generator.text<DoubleType>();
+    vector<string> names = generator.strings();
+
+    char path[] = "/tmp/column_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        throw runtime_error("cannot create temporary file");
+    }
+    close(fd);
+
+    uint64_t size = 0;
+    {
+        ofstream out(path);
+        out << "id,value,name\n";
+        for(uint64_t i = 0; i < numbers.size(); ++i)
+        {
+            out << numbers[i] << ',' << reals[i] << ',' << names[i] << '\n';
+        }
+        size = static_cast<uint64_t>(out.tellp());
+    }
+
+    runner.run("ingest_csv", numbers.size(), size, [&]() {
+        vector<unique_ptr<Column>> columns;
+        columns.push_back(make_unique<TypedColumn<PlainStore, Int64Type>>());
+        columns.push_back(make_unique<TypedColumn<PlainStore, DoubleType>>());
+        columns.push_back(make_unique<TypedColumn<DictStore, StringType>>());
+
+        vector<shared_ptr<UnaryOperator>> casters;
+        casters.push_back(make_shared<FromStringCast<Int64Type>>());
+        casters.push_back(make_shared<FromStringCast<DoubleType>>());
+        casters.push_back(make_shared<FromStringCast<StringType>>());
+
+        CsvIngest ingest(columns, casters, ',');
+        uint64_t rows = ingest.read(path);
+        doNotOptimize(rows);
+    });
+
+    remove(path);
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkConfig config;
+    try {
+        config.parse(argc, argv);
+    } catch(exception& ex)
+    {
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    BenchmarkRunner runner(config);
+    DataGenerator generator(config);
+
+    benchSplit(runner, generator);
+
+    benchFromString<Int8Type>(runner, generator);
+    benchFromString<UInt8Type>(runner, generator);
+    benchFromString<Int16Type>(runner, generator);
+    benchFromString<UInt16Type>(runner, generator);
+    benchFromString<Int32Type>(runner, generator);
+    benchFromString<UInt32Type>(runner, generator);
+    benchFromString<Int64Type>(runner, generator);
+    benchFromString<UInt64Type>(runner, generator);
+    benchFromString<FloatType>(runner, generator);
+    benchFromString<DoubleType>(runner, generator);
+    benchStringCasts(runner, generator);
+
+    benchToString<Int8Type>(runner, generator);
+    benchToString<Int16Type>(runner, generator);
+    benchToString<Int32Type>(runner, generator);
+    benchToString<Int64Type>(runner, generator);
+    benchToString<FloatType>(runner, generator);
+    benchToString<DoubleType>(runner, generator);
+
+    benchArray(runner, generator);
+    benchStores(runner, generator);
+    benchScans(runner, generator);
+    benchJoin(runner, generator);
+    benchSort(runner, generator);
+    benchTable(runner, generator);
+    benchColumnFile(runner, generator);
+    benchIngest(runner, generator);
+
+    runner.json(cout);
+
+    return 0;
+}
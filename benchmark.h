@@ -0,0 +1,232 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "types.h"
+
+struct BenchmarkConfig
+{
+    uint64_t rows = 1 << 20;
+    uint64_t cardinality = 1000;
+    uint64_t length = 16;
+    double nulls = 0.1;
+    uint64_t seed = 42;
+    double minTime = 0.5;
+    std::string filter;
+
+    // Accepts --rows=N --cardinality=N --length=N --nulls=R --seed=N --min-time=S --filter=SUBSTRING.
+    void parse(int argc, char* argv[])
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            std::string::size_type eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+            {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+
+            std::string key = arg.substr(2, eq - 2);
+            std::string value = arg.substr(eq + 1);
+            if (key == "rows") rows = std::stoull(value);
+            else if (key == "cardinality") cardinality = std::stoull(value);
+            else if (key == "length") length = std::stoull(value);
+            else if (key == "nulls") nulls = std::stod(value);
+            else if (key == "seed") seed = std::stoull(value);
+            else if (key == "min-time") minTime = std::stod(value);
+            else if (key == "filter") filter = value;
+            else throw std::invalid_argument("unknown argument " + arg);
+        }
+
+        if (cardinality == 0 || length == 0)
+        {
+            throw std::invalid_argument("cardinality and length must be positive");
+        }
+    }
+};
+
+template<typename T>
+__attribute__((always_inline))
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class DataGenerator
+{
+private:
+    BenchmarkConfig _config;
+    std::mt19937_64 _rng;
+public:
+    explicit DataGenerator(const BenchmarkConfig& config):_config(config), _rng(config.seed) {}
+    // Values are drawn from a pool of config.cardinality distinct values spread over the type's range.
+    template<typename T>
+    std::vector<typename T::c_type> numbers()
+    {
+        typedef typename T::c_type c_type;
+
+        std::vector<c_type> pool(_config.cardinality);
+        for(c_type& value : pool)
+        {
+            if (std::is_floating_point<c_type>::value)
+            {
+                value = static_cast<c_type>(std::uniform_real_distribution<double>(-1e6, 1e6)(_rng));
+            }
+            else
+            {
+                value = static_cast<c_type>(_rng());
+            }
+        }
+
+        std::vector<c_type> values(_config.rows);
+        for(c_type& value : values)
+        {
+            value = pool[_rng() % pool.size()];
+        }
+        return values;
+    }
+    // Strings average config.length bytes, ranging over [length / 2, length * 3 / 2].
+    std::vector<std::string> strings()
+    {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+        std::vector<std::string> pool(_config.cardinality);
+        uint64_t low = _config.length / 2;
+        for(std::string& value : pool)
+        {
+            uint64_t size = low + _rng() % (_config.length + 1);
+            value.resize(size == 0 ? 1 : size);
+            for(char& c : value)
+            {
+                c = alphabet[_rng() % (sizeof(alphabet) - 1)];
+            }
+        }
+
+        std::vector<std::string> values(_config.rows);
+        for(std::string& value : values)
+        {
+            value = pool[_rng() % pool.size()];
+        }
+        return values;
+    }
+    std::vector<char> nulls()
+    {
+        std::bernoulli_distribution null(_config.nulls);
+
+        std::vector<char> values(_config.rows);
+        for(char& value : values)
+        {
+            value = static_cast<char>(null(_rng));
+        }
+        return values;
+    }
+    template<typename T>
+    std::vector<std::string> text()
+    {
+        std::vector<typename T::c_type> values = numbers<T>();
+
+        std::vector<std::string> out;
+        out.reserve(values.size());
+        for(typename T::c_type value : values)
+        {
+            out.push_back(std::to_string(value));
+        }
+        return out;
+    }
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double seconds = 0;
+    uint64_t items = 0;
+    uint64_t bytes = 0;
+
+    inline double nanosPerItem() const
+    {
+        return items > 0 ? seconds * 1e9 / (static_cast<double>(iterations) * items) : 0;
+    }
+    inline double itemsPerSecond() const
+    {
+        return seconds > 0 ? static_cast<double>(iterations) * items / seconds : 0;
+    }
+    inline double bytesPerSecond() const
+    {
+        return seconds > 0 ? static_cast<double>(iterations) * bytes / seconds : 0;
+    }
+};
+
+class BenchmarkRunner
+{
+private:
+    BenchmarkConfig _config;
+    std::vector<BenchmarkResult> _results;
+public:
+    explicit BenchmarkRunner(const BenchmarkConfig& config):_config(config) {}
+    // Runs body until config.minTime has elapsed; items and bytes describe the work done by one call.
+    template<typename F>
+    void run(const std::string& name, uint64_t items, uint64_t bytes, F&& body)
+    {
+        if (!_config.filter.empty() && name.find(_config.filter) == std::string::npos)
+        {
+            return;
+        }
+
+        body();
+
+        BenchmarkResult result;
+        result.name = name;
+        result.items = items;
+        result.bytes = bytes;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        do
+        {
+            body();
+            result.iterations++;
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        while(result.seconds < _config.minTime);
+
+        _results.push_back(result);
+    }
+    inline const std::vector<BenchmarkResult>& results() const
+    {
+        return _results;
+    }
+    void json(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "  \"context\": {\"rows\": " << _config.rows
+            << ", \"cardinality\": " << _config.cardinality
+            << ", \"length\": " << _config.length
+            << ", \"nulls\": " << _config.nulls
+            << ", \"seed\": " << _config.seed
+            << ", \"min_time\": " << _config.minTime << "},\n";
+        out << "  \"benchmarks\": [";
+        for(uint64_t i = 0; i < _results.size(); ++i)
+        {
+            const BenchmarkResult& result = _results[i];
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    {\"name\": \"" << result.name << "\""
+                << ", \"iterations\": " << result.iterations
+                << ", \"seconds\": " << result.seconds
+                << ", \"items\": " << result.items
+                << ", \"bytes\": " << result.bytes
+                << ", \"ns_per_item\": " << result.nanosPerItem()
+                << ", \"items_per_second\": " << result.itemsPerSecond()
+                << ", \"bytes_per_second\": " << result.bytesPerSecond() << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,271 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "array.h"
+
+class Bitmap
+{
+private:
+    std::vector<uint64_t> _words;
+    uint64_t _size = 0;
+public:
+    explicit Bitmap(uint64_t size = 0, bool value = false)
+    {
+        resize(size, value);
+    }
+    inline void resize(uint64_t size, bool value = false)
+    {
+        uint64_t old = _size;
+        if (old % 64 != 0 && value && size > old)
+        {
+            _words.back() |= ~uint64_t(0) << (old % 64);
+        }
+        _words.resize((size + 63) / 64, value ? ~uint64_t(0) : 0);
+        _size = size;
+        clearTail();
+    }
+    inline uint64_t size() const
+    {
+        return _size;
+    }
+    inline uint64_t wordCount() const
+    {
+        return _words.size();
+    }
+    inline uint64_t* words()
+    {
+        return _words.data();
+    }
+    inline const uint64_t* words() const
+    {
+        return _words.data();
+    }
+    inline bool get(uint64_t position) const
+    {
+        return (_words[position / 64] >> (position % 64)) & 1;
+    }
+    inline void set(uint64_t position, bool value)
+    {
+        uint64_t bit = uint64_t(1) << (position % 64);
+        _words[position / 64] = value ? _words[position / 64] | bit : _words[position / 64] & ~bit;
+    }
+    // Sets rows [begin, end).
+    inline void setRange(uint64_t begin, uint64_t end)
+    {
+        while(begin < end)
+        {
+            uint64_t bits = end - begin < 64 - begin % 64 ? end - begin : 64 - begin % 64;
+            uint64_t mask = bits == 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1) << (begin % 64);
+            _words[begin / 64] |= mask;
+            begin += bits;
+        }
+    }
+    inline void push_back(bool value)
+    {
+        if (_size % 64 == 0)
+        {
+            _words.push_back(0);
+        }
+        _words.back() |= static_cast<uint64_t>(value) << (_size % 64);
+        _size++;
+    }
+    inline uint64_t count() const
+    {
+        uint64_t count = 0;
+        for(uint64_t word : _words)
+        {
+            count += static_cast<uint64_t>(__builtin_popcountll(word));
+        }
+        return count;
+    }
+    inline Bitmap& operator&=(const Bitmap& ot)
+    {
+        for(uint64_t i = 0; i < _words.size(); ++i)
+        {
+            _words[i] &= i < ot._words.size() ? ot._words[i] : 0;
+        }
+        return *this;
+    }
+    inline Bitmap& operator|=(const Bitmap& ot)
+    {
+        for(uint64_t i = 0; i < _words.size() && i < ot._words.size(); ++i)
+        {
+            _words[i] |= ot._words[i];
+        }
+        clearTail();
+        return *this;
+    }
+    inline void invert()
+    {
+        for(uint64_t& word : _words)
+        {
+            word = ~word;
+        }
+        clearTail();
+    }
+    inline void positions(std::vector<uint64_t>& out) const
+    {
+        out.clear();
+        out.reserve(count());
+        for(uint64_t i = 0; i < _words.size(); ++i)
+        {
+            uint64_t word = _words[i];
+            while(word != 0)
+            {
+                out.push_back(i * 64 + static_cast<uint64_t>(__builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+    inline void clearTail()
+    {
+        if (_size % 64 != 0)
+        {
+            _words.back() &= ~(~uint64_t(0) << (_size % 64));
+        }
+    }
+};
+
+// Arrow-compatible validity bitmap: bit i % 64 of word i / 64 is set when row i holds a value.
+class ValidityBitmap
+{
+private:
+    MappableVector<uint64_t> _words;
+    uint64_t _size = 0;
+public:
+    inline void push_back(bool valid)
+    {
+        if (_size % 64 == 0)
+        {
+            _words.push_back(0);
+        }
+        _words[_size / 64] |= static_cast<uint64_t>(valid) << (_size % 64);
+        _size++;
+    }
+    inline void append(uint64_t count, bool valid)
+    {
+        uint64_t size = _size + count;
+        if (valid && _size % 64 != 0 && count > 0)
+        {
+            _words[_size / 64] |= ~uint64_t(0) << (_size % 64);
+        }
+        _words.resize((size + 63) / 64, valid ? ~uint64_t(0) : 0);
+        _size = size;
+        if (_size % 64 != 0)
+        {
+            _words[_size / 64] &= ~(~uint64_t(0) << (_size % 64));
+        }
+    }
+    inline bool isValid(uint64_t row) const
+    {
+        return (_words[row / 64] >> (row % 64)) & 1;
+    }
+    inline bool isNull(uint64_t row) const
+    {
+        return !isValid(row);
+    }
+    inline uint64_t size() const
+    {
+        return _size;
+    }
+    inline uint64_t nullCount() const
+    {
+        uint64_t valid = 0;
+        for(uint64_t i = 0; i < _words.size(); ++i)
+        {
+            valid += static_cast<uint64_t>(__builtin_popcountll(_words[i]));
+        }
+        return _size - valid;
+    }
+    // Valid rows in [begin, end).
+    inline uint64_t count(uint64_t begin, uint64_t end) const
+    {
+        uint64_t valid = 0;
+        while(begin < end)
+        {
+            uint64_t bits = end - begin < 64 - begin % 64 ? end - begin : 64 - begin % 64;
+            uint64_t mask = bits == 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1) << (begin % 64);
+            valid += static_cast<uint64_t>(__builtin_popcountll(_words[begin / 64] & mask));
+            begin += bits;
+        }
+        return valid;
+    }
+    inline const uint64_t* words() const
+    {
+        return _words.data();
+    }
+    inline uint64_t wordCount() const
+    {
+        return _words.size();
+    }
+    // Deselects the null rows.
+    inline void intersect(Bitmap& selection) const
+    {
+        uint64_t* words = selection.words();
+        for(uint64_t i = 0; i < selection.wordCount(); ++i)
+        {
+            words[i] &= i < _words.size() ? _words[i] : 0;
+        }
+    }
+    // Selects the null rows as well, e.g. for IS NULL OR ...
+    inline void unionNulls(Bitmap& selection) const
+    {
+        uint64_t* words = selection.words();
+        for(uint64_t i = 0; i < selection.wordCount() && i < _words.size(); ++i)
+        {
+            words[i] |= ~_words[i];
+        }
+        selection.clearTail();
+    }
+    // Calls f(begin, end) for every maximal run of valid rows.
+    template<typename F>
+    inline void validRuns(F&& f) const
+    {
+        uint64_t row = 0;
+        while(row < _size)
+        {
+            row = next(row, true);
+            if (row >= _size)
+            {
+                break;
+            }
+            uint64_t end = next(row, false);
+            f(row, end < _size ? end : _size);
+            row = end;
+        }
+    }
+    inline const MappableVector<uint64_t>& data() const
+    {
+        return _words;
+    }
+    inline uint64_t capacity() const
+    {
+        return _words.capacity() * sizeof(uint64_t);
+    }
+    inline void map(const uint64_t* words, uint64_t size)
+    {
+        _words.map(words, (size + 63) / 64);
+        _size = size;
+    }
+private:
+    // First row at or after row whose validity equals valid, or past the end.
+    inline uint64_t next(uint64_t row, bool valid) const
+    {
+        uint64_t w = row / 64;
+        uint64_t word = (valid ? _words[w] : ~_words[w]) & (~uint64_t(0) << (row % 64));
+        while(word == 0)
+        {
+            if (++w >= _words.size())
+            {
+                return _words.size() * 64;
+            }
+            word = valid ? _words[w] : ~_words[w];
+        }
+        return w * 64 + static_cast<uint64_t>(__builtin_ctzll(word));
+    }
+};
+
+#endif // BITMAP_H
@@ -0,0 +1,134 @@
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "isa.h"
+
+// Frame-of-reference blocks of 128 values packed in the vertical layout of simdcomp: value i goes
+// to lane i % 4 at slot i / 4, each lane packing its 32 slots with the block's bit width. Word w of
+// lane l is stored at words[4 * w + l], so one 256-bit load brings the same word of every lane and
+// unpacked values come out in row order.
+struct BitPacking
+{
+    static constexpr uint64_t block_size = 128;
+    static constexpr uint64_t lanes = 4;
+
+    static inline uint64_t bitWidth(uint64_t range)
+    {
+        return range == 0 ? 0 : 64 - static_cast<uint64_t>(__builtin_clzll(range));
+    }
+    // Each lane packs 32 values of width bits into (width + 1) / 2 words.
+    static inline uint64_t wordCount(uint64_t width)
+    {
+        return lanes * ((width + 1) / 2);
+    }
+};
+
+// Packs block_size deltas of width bits into BitPacking::wordCount(width) zeroed words.
+inline void packBlock(const uint64_t* deltas, uint64_t width, uint64_t* words)
+{
+    if (width == 0)
+    {
+        return;
+    }
+    for(uint64_t lane = 0; lane < BitPacking::lanes; ++lane)
+    {
+        uint64_t position = 0;
+        for(uint64_t slot = 0; slot < BitPacking::block_size / BitPacking::lanes; ++slot)
+        {
+            uint64_t value = deltas[slot * BitPacking::lanes + lane];
+            uint64_t word = position / 64;
+            uint64_t shift = position % 64;
+            words[BitPacking::lanes * word + lane] |= value << shift;
+            if (shift + width > 64)
+            {
+                words[BitPacking::lanes * (word + 1) + lane] |= value >> (64 - shift);
+            }
+            position += width;
+        }
+    }
+}
+
+inline uint64_t unpackValue(const uint64_t* words, uint64_t width, uint64_t base, uint64_t index)
+{
+    if (width == 0)
+    {
+        return base;
+    }
+    uint64_t lane = index % BitPacking::lanes;
+    uint64_t position = index / BitPacking::lanes * width;
+    uint64_t word = position / 64;
+    uint64_t shift = position % 64;
+    uint64_t value = words[BitPacking::lanes * word + lane] >> shift;
+    if (shift + width > 64)
+    {
+        value |= words[BitPacking::lanes * (word + 1) + lane] << (64 - shift);
+    }
+    uint64_t mask = width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+    return base + (value & mask);
+}
+
+inline void unpackScalar(const uint64_t* words, uint64_t width, uint64_t base, uint64_t* out)
+{
+    for(uint64_t i = 0; i < BitPacking::block_size; ++i)
+    {
+        out[i] = unpackValue(words, width, base, i);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+inline void unpackAvx2(const uint64_t* words, uint64_t width, uint64_t base, uint64_t* out)
+{
+    const __m256i bases = _mm256_set1_epi64x(static_cast<long long>(base));
+    if (width == 0)
+    {
+        for(uint64_t i = 0; i < BitPacking::block_size; i += BitPacking::lanes)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bases);
+        }
+        return;
+    }
+
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1));
+    uint64_t position = 0;
+    for(uint64_t slot = 0; slot < BitPacking::block_size / BitPacking::lanes; ++slot)
+    {
+        uint64_t word = position / 64;
+        uint64_t shift = position % 64;
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + BitPacking::lanes * word));
+        __m256i values = _mm256_srl_epi64(current, _mm_cvtsi64_si128(static_cast<long long>(shift)));
+        if (shift + width > 64)
+        {
+            __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + BitPacking::lanes * (word + 1)));
+            values = _mm256_or_si256(values, _mm256_sll_epi64(next, _mm_cvtsi64_si128(static_cast<long long>(64 - shift))));
+        }
+        values = _mm256_add_epi64(_mm256_and_si256(values, mask), bases);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + slot * BitPacking::lanes), values);
+        position += width;
+    }
+}
+#endif
+
+// Decodes one block into block_size values.
+inline void unpackBlock(const uint64_t* words, uint64_t width, uint64_t base, uint64_t* out, Isa::type isa = Isa::detect())
+{
+    switch(isa)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::AVX512:
+    case Isa::AVX2:
+        unpackAvx2(words, width, base, out);
+        break;
+#endif
+    default:
+        unpackScalar(words, width, base, out);
+        break;
+    }
+}
+
+#endif // BITPACK_H
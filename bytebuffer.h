@@ -5,6 +5,8 @@
 #include <memory.h>
 #include <experimental/string_view>
 
+#include "allocator.h"
+
 class ByteBuffer;
 class ViewByteBuffer;
 
@@ -65,46 +67,55 @@ class ByteBuffer
 public:
     uint64_t _size = 0;
     char* _data = nullptr;
+    Allocator* _allocator = nullptr;
 public:
     ByteBuffer():_size(0),_data(nullptr) {}
-    ByteBuffer(uint64_t size, const char* data):_size(size)
+    ByteBuffer(uint64_t size, const char* data, Allocator* allocator = nullptr):_size(size),_allocator(allocator)
     {
-        _data = new char[size];
+        _data = allocate(size);
         memcpy(_data, data, size);
     }
     ByteBuffer(const ByteBuffer& ot)
     {
         _size = ot._size;
-        _data = new char[ot._size];
+        _allocator = ot._allocator;
+        _data = allocate(ot._size);
         memcpy(_data, ot._data, ot._size);
     }
     ByteBuffer& operator=(const ByteBuffer& ot)
     {
-        _size = ot._size;
-        _data = new char[ot._size];
-        memcpy(_data, ot._data, ot._size);
+        if (this != &ot)
+        {
+            release();
+            _size = ot._size;
+            _allocator = ot._allocator;
+            _data = allocate(ot._size);
+            memcpy(_data, ot._data, ot._size);
+        }
         return *this;
     }
     ByteBuffer(ByteBuffer&& ot)
     {
         _size = ot._size;
         _data = ot._data;
+        _allocator = ot._allocator;
         ot._data = nullptr;
     }
     ByteBuffer& operator=(ByteBuffer&& ot)
     {
-        _size = ot._size;
-        _data = ot._data;
-        ot._data = nullptr;
+        if (this != &ot)
+        {
+            release();
+            _size = ot._size;
+            _data = ot._data;
+            _allocator = ot._allocator;
+            ot._data = nullptr;
+        }
         return *this;
     }
     ~ByteBuffer()
     {
-        if (_data != nullptr)
-        {
-            delete[] _data;
-            _data = nullptr;
-        }
+        release();
         _size = 0;
     }
     ByteBuffer(const ViewByteBuffer& ot);
@@ -117,27 +128,44 @@ public:
 
         return out;
     }
+private:
+    inline char* allocate(uint64_t size)
+    {
+        return _allocator != nullptr ? _allocator->allocate(size, 1) : new char[size];
+    }
+    inline void release()
+    {
+        if (_data != nullptr)
+        {
+            if (_allocator != nullptr)
+            {
+                _allocator->release(_data, _size, 1);
+            }
+            else
+            {
+                delete[] _data;
+            }
+            _data = nullptr;
+        }
+    }
 };
 
-ViewByteBuffer::ViewByteBuffer(const ByteBuffer& ot)
+inline ViewByteBuffer::ViewByteBuffer(const ByteBuffer& ot)
 {
     _size = ot._size;
     _data = ot._data;
 }
 
-ByteBuffer::ByteBuffer(const ViewByteBuffer& ot)
+inline ByteBuffer::ByteBuffer(const ViewByteBuffer& ot)
 {
     _size = ot._size;
-    _data = new char[ot._size];
+    _data = allocate(ot._size);
     memcpy(_data, ot._data, ot._size);
 }
 
-namespace std
+inline bool operator<(const ByteBuffer& lv, const ByteBuffer& rv)
 {
-    bool operator<(const ByteBuffer& lv, const ByteBuffer& rv)
-    {
-        return std::experimental::string_view(lv._data, lv._size) < std::experimental::string_view(rv._data, rv._size);
-    }
+    return std::experimental::string_view(lv._data, lv._size) < std::experimental::string_view(rv._data, rv._size);
 }
 
 #endif // BYTEBUFFER_H
@@ -2,46 +2,216 @@
 #define COLUMN_H
 
 #include <vector>
-#include <set>
+#include <limits>
+#include <algorithm>
 #include <string>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
 
 #include "types.h"
 #include "bytebuffer.h"
 #include "array.h"
+#include "hash.h"
+#include "bitmap.h"
+#include "zonemap.h"
+#include "bitpack.h"
+#include "compress.h"
 
 struct Encoding
 {
     enum type
     {
         PLAIN = 0,
-        DICTIONARY = 1
+        DICTIONARY = 1,
+        RLE = 2,
+        BITPACKED = 3,
+        DELTA = 4,
+        COMPRESSED = 5,
+        // Picked per row group by AdaptiveColumn in adaptive.h.
+        ADAPTIVE = 6
     };
 };
 
 template<Encoding::type TYPE>
-struct Store {};
+struct Store
+{
+    static constexpr Encoding::type encoding = TYPE;
+};
 
 typedef Store<Encoding::PLAIN> PlainStore;
 typedef Store<Encoding::DICTIONARY> DictStore;
+typedef Store<Encoding::RLE> RleStore;
+typedef Store<Encoding::BITPACKED> BitPackedStore;
+typedef Store<Encoding::DELTA> DeltaStore;
+typedef Store<Encoding::COMPRESSED> CompressedStore;
+
+struct ColumnDescriptor
+{
+    uint32_t type;
+    uint32_t encoding;
+    uint32_t nullable;
+    uint32_t sections;
+    uint64_t rows;
+};
+
+struct Section
+{
+    const char* data;
+    uint64_t size;
+    uint64_t chunkSize;
+};
+
+class ColumnWriter
+{
+public:
+    virtual ~ColumnWriter() {}
+    virtual void begin(const ColumnDescriptor& descriptor) = 0;
+    virtual void beginSection(uint64_t chunkSize) = 0;
+    virtual void write(const char* data, uint64_t size) = 0;
+    virtual void endSection() = 0;
+    virtual void end() = 0;
+    inline void section(const char* data, uint64_t size)
+    {
+        beginSection(0);
+        write(data, size);
+        endSection();
+    }
+    inline void section(Array& array)
+    {
+        beginSection(array.chunkSize());
+        for(uint64_t i = 0; i < array.chunkCount(); ++i)
+        {
+            ArrayChunk chunk = array.chunk(i);
+            write(chunk.data, chunk.size);
+        }
+        endSection();
+    }
+    template<typename T>
+    inline void section(const MappableVector<T>& values)
+    {
+        section(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+    template<typename T>
+    inline void section(ZoneMap<T>& zones)
+    {
+        uint64_t groupSize = zones.groupSize();
+        section(reinterpret_cast<const char*>(&groupSize), sizeof(groupSize));
+        section(zones.zones());
+    }
+    inline void section(const ValidityBitmap& validity)
+    {
+        section(validity.data());
+    }
+};
+
+class ColumnReader
+{
+public:
+    virtual ~ColumnReader() {}
+    virtual const ColumnDescriptor& descriptor() = 0;
+    virtual Section next() = 0;
+    // Keeps the memory behind the sections alive for as long as the loaded column.
+    virtual std::shared_ptr<const void> owner() = 0;
+    inline void next(Array& array)
+    {
+        Section section = next();
+        array.map(section.data, section.size, section.chunkSize);
+    }
+    template<typename T>
+    inline void next(MappableVector<T>& values)
+    {
+        Section section = next();
+        values.map(reinterpret_cast<const T*>(section.data), section.size / sizeof(T));
+    }
+    template<typename T>
+    inline void next(ZoneMap<T>& zones)
+    {
+        Section meta = next();
+        if (meta.size != sizeof(uint64_t))
+        {
+            throw std::runtime_error("malformed zone map section");
+        }
+        uint64_t groupSize;
+        memcpy(&groupSize, meta.data, sizeof(groupSize));
+        Section section = next();
+        zones.map(groupSize, reinterpret_cast<const Zone<T>*>(section.data), section.size / sizeof(Zone<T>));
+    }
+    inline void next(ValidityBitmap& validity)
+    {
+        uint64_t rows = descriptor().rows;
+        Section section = next();
+        if (section.size < (rows + 63) / 64 * sizeof(uint64_t))
+        {
+            throw std::runtime_error("malformed validity section");
+        }
+        validity.map(reinterpret_cast<const uint64_t*>(section.data), rows);
+    }
+};
 
 class Column
 {
+protected:
+    std::shared_ptr<const void> _owner;
 public:
     virtual ~Column() {}
     virtual void put(ByteBuffer& value) = 0;
     virtual ByteBuffer get(uint64_t position) = 0;
     virtual void put(ViewByteBuffer& value) = 0;
+    // A view into the column's storage, valid while the column is not modified. Values the column
+    // decodes are the exception: bit packed and delta coded integers land in a single slot of the
+    // store that the next getView() overwrites, and compressed strings in a page cache. Such a view
+    // must be used before the next read and not shared across threads.
     virtual ViewByteBuffer getView(uint64_t position) = 0;
+    // Like getView(), but a fixed width value the column decodes is written to buffer, which holds at
+    // least sizeof(uint64_t) bytes, and the view lasts as long as buffer does.
+    virtual ViewByteBuffer decodeView(uint64_t position, char* buffer)
+    {
+        return getView(position);
+    }
+    virtual void putBatch(ViewByteBuffer* values, uint64_t count)
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            put(values[i]);
+        }
+    }
+    virtual void putBatch(const char* data, uint64_t count)
+    {
+        throw std::logic_error("putBatch of raw values on a variable width column");
+    }
+    // Rows held, null rows included.
+    virtual uint64_t size() = 0;
+    // Bytes held by the column, including bookkeeping outside its allocator.
+    virtual uint64_t memoryUsage()
+    {
+        return 0;
+    }
+    virtual void save(ColumnWriter& writer)
+    {
+        throw std::logic_error("column does not support save");
+    }
+    // Serves the column from the reader's sections without copying; the column becomes read-only.
+    virtual void load(ColumnReader& reader)
+    {
+        throw std::logic_error("column does not support load");
+    }
 };
 
+// Nullable columns keep one slot per row: put() appends a valid row and putNull() a null one.
 class IsNullable
 {
 protected:
-    std::vector<char> _nulls;
+    ValidityBitmap _validity;
 public:
     virtual ~IsNullable() {}
-    virtual void putNull(bool value) = 0;
+    virtual void putNull() = 0;
     virtual bool getNull(uint64_t position) = 0;
+    // False for a column that has the interface but was made without nulls.
+    virtual bool nullable()
+    {
+        return true;
+    }
 };
 
 class Storage
@@ -52,148 +222,1460 @@ public:
     virtual ByteBuffer get(uint64_t offset, uint64_t type_size) = 0;
     virtual uint64_t put(ViewByteBuffer& value) = 0;
     virtual ViewByteBuffer getView(uint64_t offset, uint64_t type_size) = 0;
+    // Like getView(), with a value the store decodes written to buffer of at least type_size bytes.
+    virtual ViewByteBuffer decodeView(uint64_t offset, uint64_t type_size, char* buffer)
+    {
+        return getView(offset, type_size);
+    }
 };
 
 template<typename T>
 class TypeStore: public Storage {};
 
+template<typename T>
+struct ColumnChunk
+{
+    const typename T::c_type* data;
+    uint64_t offset;
+    uint64_t size;
+};
+
 template<>
 class TypeStore<PlainStore>: public Storage
 {
 private:
     Array _data;
 public:
+    explicit TypeStore(Allocator* allocator = nullptr):_data(Array::default_chunk_size, false, allocator) {}
     uint64_t put(ByteBuffer& value) override
     {
-        uint64_t offset = _data.size();
-
-        _data.emplace_back(value._size, value._data);
-
-        return offset;
+        return _data.emplace_back(value._size, value._data);
     }
     ByteBuffer get(uint64_t offset, uint64_t type_size) override
     {
-        ByteBuffer value(type_size, _data.get(offset));
+        ByteBuffer value(type_size, type_size > 0 ? _data.get(offset) : nullptr);
         return value;
     }
     uint64_t put(ViewByteBuffer& value) override
     {
-        uint64_t offset = _data.size();
-
-        _data.emplace_back(value._size, value._data);
-
-        return offset;
+        return _data.emplace_back(value._size, value._data);
     }
     ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
     {
-        ViewByteBuffer value(type_size, _data.get(offset));
+        ViewByteBuffer value(type_size, type_size > 0 ? _data.get(offset) : nullptr);
         return value;
     }
+    inline uint64_t append(ViewByteBuffer& values)
+    {
+        return _data.append(values._size, values._data);
+    }
+    inline uint64_t reserve(uint64_t size)
+    {
+        return _data.reserve(size);
+    }
+    inline uint64_t chunkCount()
+    {
+        return _data.chunkCount();
+    }
+    inline ArrayChunk chunk(uint64_t index)
+    {
+        return _data.chunk(index);
+    }
+    inline uint64_t size()
+    {
+        return _data.size();
+    }
+    inline uint64_t overhead()
+    {
+        return 0;
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        writer.section(_data);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        reader.next(_data);
+    }
 };
 
 template<>
 class TypeStore<DictStore>: public Storage
 {
 private:
-    std::vector<ByteBuffer*> _position;
-    std::set<ByteBuffer> _set;
+    Array _arena;
+    MappableVector<uint64_t> _offsets;
+    MappableVector<uint64_t> _lengths;
+    MappableVector<uint64_t> _hashes;
+    MappableVector<uint32_t> _slots;
+    uint64_t _mask = 0;
+    MappableVector<char> _codes;
+    uint64_t _codeWidth = 1;
+    uint64_t _rows = 0;
 public:
+    explicit TypeStore(Allocator* allocator = nullptr):_arena(Array::default_chunk_size, false, allocator)
+    {
+        _slots.resize(1024, 0);
+        _mask = _slots.size() - 1;
+    }
     uint64_t put(ByteBuffer& value) override
     {
-        uint64_t offset = _position.size();
+        ViewByteBuffer view(value);
+        return put(view);
+    }
+    ByteBuffer get(uint64_t offset, uint64_t type_size) override
+    {
+        return ByteBuffer(getView(offset, type_size));
+    }
+    uint64_t put(ViewByteBuffer& value) override
+    {
+        uint32_t code = intern(value);
+
+        if (_hashes.size() > (uint64_t(1) << (8 * _codeWidth)))
+        {
+            widen();
+        }
+        _codes.resize(_codes.size() + _codeWidth);
+        memcpy(&_codes[_rows * _codeWidth], &code, _codeWidth);
+
+        return _rows++;
+    }
+    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    {
+        return value(code(offset));
+    }
+    inline uint32_t code(uint64_t row)
+    {
+        uint32_t code = 0;
+        memcpy(&code, &_codes[row * _codeWidth], _codeWidth);
+        return code;
+    }
+    inline ViewByteBuffer value(uint32_t code)
+    {
+        return ViewByteBuffer(_lengths[code], _lengths[code] > 0 ? _arena.get(_offsets[code]) : nullptr);
+    }
+    inline int64_t find(ViewByteBuffer& value)
+    {
+        uint64_t hash = hashBytes(value._data, value._size);
+        for(uint64_t slot = hash & _mask; _slots[slot] != 0; slot = (slot + 1) & _mask)
+        {
+            uint32_t code = _slots[slot] - 1;
+            if (matches(code, hash, value))
+            {
+                return code;
+            }
+        }
+        return -1;
+    }
+    inline uint64_t cardinality()
+    {
+        return _hashes.size();
+    }
+    inline uint64_t codeWidth()
+    {
+        return _codeWidth;
+    }
+    inline const char* codes()
+    {
+        return _codes.data();
+    }
+    inline uint64_t size()
+    {
+        return _rows;
+    }
+    inline uint64_t overhead()
+    {
+        return (_offsets.capacity() + _lengths.capacity() + _hashes.capacity()) * sizeof(uint64_t)
+            + _slots.capacity() * sizeof(uint32_t) + _codes.capacity();
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        uint64_t meta[2] = {_codeWidth, _rows};
+        writer.section(reinterpret_cast<const char*>(meta), sizeof(meta));
+        writer.section(_arena);
+        writer.section(_offsets);
+        writer.section(_lengths);
+        writer.section(_hashes);
+        writer.section(_slots);
+        writer.section(_codes);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        Section meta = reader.next();
+        if (meta.size != 2 * sizeof(uint64_t))
+        {
+            throw std::runtime_error("invalid dictionary section");
+        }
+        memcpy(&_codeWidth, meta.data, sizeof(uint64_t));
+        memcpy(&_rows, meta.data + sizeof(uint64_t), sizeof(uint64_t));
+        reader.next(_arena);
+        reader.next(_offsets);
+        reader.next(_lengths);
+        reader.next(_hashes);
+        reader.next(_slots);
+        reader.next(_codes);
+        _mask = _slots.size() - 1;
+    }
+private:
+    inline bool matches(uint32_t code, uint64_t hash, ViewByteBuffer& value)
+    {
+        return _hashes[code] == hash
+            && _lengths[code] == value._size
+            && (value._size == 0 || memcmp(_arena.get(_offsets[code]), value._data, value._size) == 0);
+    }
+    inline uint32_t intern(ViewByteBuffer& value)
+    {
+        uint64_t hash = hashBytes(value._data, value._size);
+        uint64_t slot = hash & _mask;
+        for(; _slots[slot] != 0; slot = (slot + 1) & _mask)
+        {
+            uint32_t code = _slots[slot] - 1;
+            if (matches(code, hash, value))
+            {
+                return code;
+            }
+        }
+
+        uint32_t code = static_cast<uint32_t>(_hashes.size());
+        _offsets.push_back(_arena.emplace_back(value._size, value._data));
+        _lengths.push_back(value._size);
+        _hashes.push_back(hash);
+        _slots[slot] = code + 1;
+
+        if (_hashes.size() * 2 > _slots.size())
+        {
+            rehash();
+        }
+
+        return code;
+    }
+    inline void rehash()
+    {
+        std::vector<uint32_t> slots(_slots.size() * 2, 0);
+        uint64_t mask = slots.size() - 1;
+        for(uint32_t code = 0; code < _hashes.size(); ++code)
+        {
+            uint64_t slot = _hashes[code] & mask;
+            while(slots[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = code + 1;
+        }
+        _slots.swap(slots);
+        _mask = mask;
+    }
+    inline void widen()
+    {
+        uint64_t width = _codeWidth * 2;
+        std::vector<char> codes(_rows * width, 0);
+        for(uint64_t row = 0; row < _rows; ++row)
+        {
+            memcpy(&codes[row * width], &_codes[row * _codeWidth], _codeWidth);
+        }
+        _codes.swap(codes);
+        _codeWidth = width;
+    }
+};
 
-        auto find = _set.find(value);
-        if (_set.end() == find)
+// Run-length encoding: each run keeps its value once and the row just past its end, so a row is
+// found by binary search over the run ends. put() returns the row.
+template<>
+class TypeStore<RleStore>: public Storage
+{
+private:
+    Array _arena;
+    MappableVector<uint64_t> _ends;
+    MappableVector<uint64_t> _offsets;
+    MappableVector<uint64_t> _lengths;
+public:
+    static constexpr uint64_t arena_chunk_size = 64 * 1024;
+
+    explicit TypeStore(Allocator* allocator = nullptr):_arena(arena_chunk_size, false, allocator) {}
+    uint64_t put(ByteBuffer& value) override
+    {
+        ViewByteBuffer view(value);
+        return putRun(view, 1);
+    }
+    ByteBuffer get(uint64_t offset, uint64_t type_size) override
+    {
+        return ByteBuffer(getView(offset, type_size));
+    }
+    uint64_t put(ViewByteBuffer& value) override
+    {
+        return putRun(value, 1);
+    }
+    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    {
+        return value(run(offset));
+    }
+    // Appends count copies of value and returns the row of the first one.
+    inline uint64_t putRun(ViewByteBuffer& value, uint64_t count)
+    {
+        uint64_t row = size();
+        uint64_t runs = _ends.size();
+        if (runs > 0 && _lengths[runs - 1] == value._size
+            && (value._size == 0 || memcmp(_arena.get(_offsets[runs - 1]), value._data, value._size) == 0))
         {
-            _set.insert(value);
-            find = _set.find(value);
+            _ends[runs - 1] += count;
+            return row;
         }
-        _position.emplace_back(const_cast<ByteBuffer*>(&*find));
 
-        return offset;
+        _offsets.push_back(_arena.emplace_back(value._size, value._data));
+        _lengths.push_back(value._size);
+        _ends.push_back(row + count);
+        return row;
+    }
+    // Repeats the value of the last run count more times.
+    inline void extend(uint64_t count)
+    {
+        _ends[_ends.size() - 1] += count;
+    }
+    // Index of the run holding row.
+    inline uint64_t run(uint64_t row)
+    {
+        const uint64_t* ends = _ends.data();
+        return static_cast<uint64_t>(std::upper_bound(ends, ends + _ends.size(), row) - ends);
+    }
+    inline uint64_t runCount()
+    {
+        return _ends.size();
+    }
+    inline uint64_t runStart(uint64_t index)
+    {
+        return index > 0 ? _ends[index - 1] : 0;
+    }
+    inline uint64_t runEnd(uint64_t index)
+    {
+        return _ends[index];
+    }
+    inline ViewByteBuffer value(uint64_t index)
+    {
+        return ViewByteBuffer(_lengths[index], _lengths[index] > 0 ? _arena.get(_offsets[index]) : nullptr);
+    }
+    inline uint64_t size()
+    {
+        return _ends.empty() ? 0 : _ends[_ends.size() - 1];
+    }
+    inline uint64_t overhead()
+    {
+        return (_ends.capacity() + _offsets.capacity() + _lengths.capacity()) * sizeof(uint64_t);
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        writer.section(_arena);
+        writer.section(_ends);
+        writer.section(_offsets);
+        writer.section(_lengths);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        reader.next(_arena);
+        reader.next(_ends);
+        reader.next(_offsets);
+        reader.next(_lengths);
+    }
+};
+
+// Frame-of-reference bit packing for integers. Every full block of 128 values keeps its minimum
+// and the deltas from it packed at the smallest bit width; the last partial block stays unpacked.
+// Values are ranged as signed or as unsigned, whichever is narrower, and decode the same way
+// either way. put() returns the row.
+template<>
+class TypeStore<BitPackedStore>: public Storage
+{
+private:
+    MappableVector<uint64_t> _words;
+    MappableVector<uint64_t> _bases;
+    MappableVector<uint64_t> _offsets;
+    MappableVector<uint8_t> _widths;
+    MappableVector<uint64_t> _pending;
+    uint64_t _valueSize = 0;
+    uint64_t _value = 0;
+public:
+    explicit TypeStore(Allocator* = nullptr) {}
+    uint64_t put(ByteBuffer& value) override
+    {
+        ViewByteBuffer view(value);
+        return put(view);
     }
     ByteBuffer get(uint64_t offset, uint64_t type_size) override
     {
-        return *_position.at(offset);
+        return ByteBuffer(getView(offset, type_size));
     }
     uint64_t put(ViewByteBuffer& value) override
     {
-        ByteBuffer buffer(value);
-        uint64_t offset = _position.size();
+        if (value._size == 0 || value._size > sizeof(uint64_t))
+        {
+            throw std::invalid_argument("bit packing needs integers of 1 to 8 bytes");
+        }
+        uint64_t row = size();
+        _valueSize = value._size;
+
+        uint64_t bits = 0;
+        memcpy(&bits, value._data, value._size);
+        _pending.push_back(bits);
+        if (_pending.size() == BitPacking::block_size)
+        {
+            flush();
+        }
+        return row;
+    }
+    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    {
+        return decodeView(offset, type_size, reinterpret_cast<char*>(&_value));
+    }
+    ViewByteBuffer decodeView(uint64_t offset, uint64_t type_size, char* buffer) override
+    {
+        uint64_t block = offset / BitPacking::block_size;
+        uint64_t index = offset % BitPacking::block_size;
+        uint64_t value = block < _bases.size()
+            ? unpackValue(_words.data() + _offsets[block], _widths[block], _bases[block], index)
+            : _pending[index];
+        memcpy(buffer, &value, _valueSize);
+        return ViewByteBuffer(_valueSize, buffer);
+    }
+    // Blocks including the partial one.
+    inline uint64_t blockCount()
+    {
+        return _bases.size() + (_pending.empty() ? 0 : 1);
+    }
+    // Decodes a block into out, truncating each value to C, and returns how many rows it holds.
+    template<typename C>
+    inline uint64_t decode(uint64_t block, C* out, Isa::type isa = Isa::detect())
+    {
+        if (block >= _bases.size())
+        {
+            for(uint64_t i = 0; i < _pending.size(); ++i)
+            {
+                out[i] = static_cast<C>(_pending[i]);
+            }
+            return _pending.size();
+        }
+
+        if constexpr (sizeof(C) == sizeof(uint64_t))
+        {
+            unpackBlock(_words.data() + _offsets[block], _widths[block], _bases[block], reinterpret_cast<uint64_t*>(out), isa);
+        }
+        else
+        {
+            uint64_t values[BitPacking::block_size];
+            unpackBlock(_words.data() + _offsets[block], _widths[block], _bases[block], values, isa);
+            for(uint64_t i = 0; i < BitPacking::block_size; ++i)
+            {
+                out[i] = static_cast<C>(values[i]);
+            }
+        }
+        return BitPacking::block_size;
+    }
+    inline uint64_t width(uint64_t block)
+    {
+        return block < _widths.size() ? _widths[block] : _valueSize * 8;
+    }
+    inline uint64_t size()
+    {
+        return _bases.size() * BitPacking::block_size + _pending.size();
+    }
+    inline uint64_t overhead()
+    {
+        return (_words.capacity() + _bases.capacity() + _offsets.capacity() + _pending.capacity()) * sizeof(uint64_t)
+            + _widths.capacity();
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        writer.section(reinterpret_cast<const char*>(&_valueSize), sizeof(_valueSize));
+        writer.section(_words);
+        writer.section(_bases);
+        writer.section(_offsets);
+        writer.section(_widths);
+        writer.section(_pending);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        Section meta = reader.next();
+        if (meta.size != sizeof(uint64_t))
+        {
+            throw std::runtime_error("invalid bit packing section");
+        }
+        memcpy(&_valueSize, meta.data, sizeof(uint64_t));
+        reader.next(_words);
+        reader.next(_bases);
+        reader.next(_offsets);
+        reader.next(_widths);
+        reader.next(_pending);
+    }
+private:
+    inline void flush()
+    {
+        uint64_t shift = 64 - 8 * _valueSize;
+        uint64_t extended[BitPacking::block_size];
+        uint64_t low = ~uint64_t(0);
+        uint64_t high = 0;
+        int64_t signedLow = std::numeric_limits<int64_t>::max();
+        int64_t signedHigh = std::numeric_limits<int64_t>::min();
+        for(uint64_t i = 0; i < BitPacking::block_size; ++i)
+        {
+            uint64_t value = _pending[i];
+            int64_t signedValue = static_cast<int64_t>(value << shift) >> shift;
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+            signedLow = signedValue < signedLow ? signedValue : signedLow;
+            signedHigh = signedValue > signedHigh ? signedValue : signedHigh;
+            extended[i] = static_cast<uint64_t>(signedValue);
+        }
+
+        uint64_t base = low;
+        uint64_t range = high - low;
+        uint64_t signedRange = static_cast<uint64_t>(signedHigh) - static_cast<uint64_t>(signedLow);
+        bool useSigned = signedRange < range;
+        if (useSigned)
+        {
+            base = static_cast<uint64_t>(signedLow);
+            range = signedRange;
+        }
 
-        auto find = _set.find(buffer);
-        if (_set.end() == find)
+        uint64_t width = BitPacking::bitWidth(range);
+        uint64_t deltas[BitPacking::block_size];
+        for(uint64_t i = 0; i < BitPacking::block_size; ++i)
         {
-            _set.insert(buffer);
-            find = _set.find(buffer);
+            deltas[i] = (useSigned ? extended[i] : _pending[i]) - base;
         }
-        _position.emplace_back(const_cast<ByteBuffer*>(&*find));
 
-        return offset;
+        uint64_t offset = _words.size();
+        _words.resize(offset + BitPacking::wordCount(width), 0);
+        packBlock(deltas, width, _words.data() + offset);
+        _bases.push_back(base);
+        _offsets.push_back(offset);
+        _widths.push_back(static_cast<uint8_t>(width));
+        _pending.resize(0);
+    }
+};
+
+// Delta-of-delta coding for 64-bit integers such as timestamps, after Gorilla. Every checkpoint
+// block of 128 rows keeps its first value and the bit position of its stream; the stream codes each
+// following delta-of-delta with a unary bucket prefix of 0 to 4 one bits, for 0, 7, 16, 32 or 64
+// payload bits of zigzag. put() returns the row.
+template<>
+class TypeStore<DeltaStore>: public Storage
+{
+public:
+    static constexpr uint64_t checkpoint_interval = 128;
+private:
+    struct State
+    {
+        uint64_t rows;
+        uint64_t bits;
+        int64_t last;
+        int64_t delta;
+        uint64_t sorted;
+    };
+
+    MappableVector<uint64_t> _bits;
+    MappableVector<int64_t> _checkpoints;
+    MappableVector<uint64_t> _positions;
+    State _state{0, 0, 0, 0, 1};
+    int64_t _value = 0;
+public:
+    explicit TypeStore(Allocator* = nullptr) {}
+    uint64_t put(ByteBuffer& value) override
+    {
+        ViewByteBuffer view(value);
+        return put(view);
+    }
+    ByteBuffer get(uint64_t offset, uint64_t type_size) override
+    {
+        return ByteBuffer(getView(offset, type_size));
+    }
+    uint64_t put(ViewByteBuffer& value) override
+    {
+        if (value._size != sizeof(int64_t))
+        {
+            throw std::invalid_argument("delta coding needs 64-bit integers");
+        }
+        int64_t v;
+        memcpy(&v, value._data, sizeof(v));
+        return append(v);
+    }
+    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    {
+        return decodeView(offset, type_size, reinterpret_cast<char*>(&_value));
+    }
+    ViewByteBuffer decodeView(uint64_t offset, uint64_t type_size, char* buffer) override
+    {
+        uint64_t block = offset / checkpoint_interval;
+        int64_t value = _checkpoints[block];
+        int64_t delta = 0;
+        uint64_t position = _positions[block];
+        for(uint64_t i = 0; i < offset % checkpoint_interval; ++i)
+        {
+            next(position, value, delta);
+        }
+        memcpy(buffer, &value, sizeof(value));
+        return ViewByteBuffer(sizeof(value), buffer);
+    }
+    // Repeats the last value count more times.
+    inline void extend(uint64_t count)
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            append(_state.last);
+        }
+    }
+    inline uint64_t blockCount()
+    {
+        return _checkpoints.size();
+    }
+    // Decodes a checkpoint block into out and returns how many rows it holds.
+    inline uint64_t decode(uint64_t block, int64_t* out)
+    {
+        uint64_t first = block * checkpoint_interval;
+        uint64_t rows = _state.rows - first < checkpoint_interval ? _state.rows - first : checkpoint_interval;
+        int64_t value = _checkpoints[block];
+        int64_t delta = 0;
+        uint64_t position = _positions[block];
+        out[0] = value;
+        for(uint64_t i = 1; i < rows; ++i)
+        {
+            next(position, value, delta);
+            out[i] = value;
+        }
+        return rows;
+    }
+    // True while every value is at least the one before it.
+    inline bool sorted()
+    {
+        return _state.sorted != 0;
+    }
+    // First row whose value is not less than value (upper: greater than value); sorted stores only.
+    inline uint64_t lowerBound(int64_t value, bool upper = false)
+    {
+        const int64_t* checkpoints = _checkpoints.data();
+        uint64_t block = upper
+            ? static_cast<uint64_t>(std::upper_bound(checkpoints, checkpoints + _checkpoints.size(), value) - checkpoints)
+            : static_cast<uint64_t>(std::lower_bound(checkpoints, checkpoints + _checkpoints.size(), value) - checkpoints);
+        if (block == 0)
+        {
+            return 0;
+        }
+        block--;
+
+        int64_t values[checkpoint_interval];
+        uint64_t rows = decode(block, values);
+        uint64_t i = upper
+            ? static_cast<uint64_t>(std::upper_bound(values, values + rows, value) - values)
+            : static_cast<uint64_t>(std::lower_bound(values, values + rows, value) - values);
+        return block * checkpoint_interval + i;
+    }
+    inline uint64_t upperBound(int64_t value)
+    {
+        return lowerBound(value, true);
+    }
+    inline uint64_t size()
+    {
+        return _state.rows;
+    }
+    inline uint64_t overhead()
+    {
+        return (_bits.capacity() + _checkpoints.capacity() + _positions.capacity()) * sizeof(uint64_t);
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        writer.section(reinterpret_cast<const char*>(&_state), sizeof(_state));
+        writer.section(_bits);
+        writer.section(_checkpoints);
+        writer.section(_positions);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        Section meta = reader.next();
+        if (meta.size != sizeof(State))
+        {
+            throw std::runtime_error("invalid delta section");
+        }
+        memcpy(&_state, meta.data, sizeof(State));
+        reader.next(_bits);
+        reader.next(_checkpoints);
+        reader.next(_positions);
+    }
+private:
+    inline uint64_t append(int64_t value)
+    {
+        uint64_t row = _state.rows;
+        if (row > 0 && value < _state.last)
+        {
+            _state.sorted = 0;
+        }
+
+        if (row % checkpoint_interval == 0)
+        {
+            _checkpoints.push_back(value);
+            _positions.push_back(_state.bits);
+            _state.delta = 0;
+        }
+        else
+        {
+            int64_t delta = static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(_state.last));
+            uint64_t dod = static_cast<uint64_t>(delta) - static_cast<uint64_t>(_state.delta);
+            uint64_t zigzag = (dod << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(dod) >> 63);
+            if (zigzag == 0)
+            {
+                write(0, 1);
+            }
+            else if (zigzag < (uint64_t(1) << 7))
+            {
+                write(0x1, 2);
+                write(zigzag, 7);
+            }
+            else if (zigzag < (uint64_t(1) << 16))
+            {
+                write(0x3, 3);
+                write(zigzag, 16);
+            }
+            else if (zigzag < (uint64_t(1) << 32))
+            {
+                write(0x7, 4);
+                write(zigzag, 32);
+            }
+            else
+            {
+                write(0xf, 4);
+                write(zigzag, 64);
+            }
+            _state.delta = delta;
+        }
+
+        _state.last = value;
+        _state.rows++;
+        return row;
+    }
+    inline void write(uint64_t value, uint64_t count)
+    {
+        uint64_t shift = _state.bits % 64;
+        if (shift == 0)
+        {
+            _bits.push_back(0);
+        }
+        _bits[_bits.size() - 1] |= value << shift;
+        if (shift + count > 64)
+        {
+            _bits.push_back(value >> (64 - shift));
+        }
+        _state.bits += count;
+    }
+    inline uint64_t read(uint64_t position, uint64_t count)
+    {
+        uint64_t word = position / 64;
+        uint64_t shift = position % 64;
+        uint64_t value = _bits[word] >> shift;
+        if (shift + count > 64)
+        {
+            value |= _bits[word + 1] << (64 - shift);
+        }
+        return count == 64 ? value : value & ((uint64_t(1) << count) - 1);
+    }
+    inline void next(uint64_t& position, int64_t& value, int64_t& delta)
+    {
+        static const uint64_t payload[5] = {0, 7, 16, 32, 64};
+
+        uint64_t remaining = _state.bits - position;
+        uint64_t prefix = read(position, remaining < 4 ? remaining : 4);
+        uint64_t bucket = static_cast<uint64_t>(__builtin_ctzll(~prefix));
+        bucket = bucket > 4 ? 4 : bucket;
+        position += bucket < 4 ? bucket + 1 : 4;
+
+        uint64_t zigzag = bucket == 0 ? 0 : read(position, payload[bucket]);
+        position += payload[bucket];
+
+        uint64_t dod = (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+        delta = static_cast<int64_t>(static_cast<uint64_t>(delta) + dod);
+        value = static_cast<int64_t>(static_cast<uint64_t>(value) + static_cast<uint64_t>(delta));
+    }
+};
+
+// Strings packed back to back into pages of about page_size bytes, each compressed once full. A row
+// is found through its page, by binary search over the first rows, and its offset in the page.
+// getView() decompresses a page on first touch into a small LRU cache; a view stays valid until its
+// page is evicted, so for at least cache_pages - 1 touches of other pages. put() returns the row.
+template<>
+class TypeStore<CompressedStore>: public Storage
+{
+public:
+    static constexpr uint64_t page_size = 64 * 1024;
+    static constexpr uint64_t default_cache_pages = 8;
+    static constexpr uint64_t data_chunk_size = 1024 * 1024;
+private:
+    struct Page
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t rawSize;
+        uint64_t firstRow;
+        uint64_t codec;
+    };
+    struct CachedPage
+    {
+        uint64_t page;
+        uint64_t used;
+        std::vector<char> data;
+    };
+    struct State
+    {
+        uint64_t codec;
+        uint64_t rows;
+        uint64_t rawBytes;
+        uint64_t openFirst;
+    };
+
+    Array _data;
+    MappableVector<Page> _pages;
+    MappableVector<uint32_t> _positions;
+    MappableVector<char> _open;
+    std::vector<char> _scratch;
+    std::vector<CachedPage> _cache;
+    // The page touched last, which the cache cannot have evicted since.
+    const char* _current = nullptr;
+    uint64_t _currentFirst = 0;
+    uint64_t _currentEnd = 0;
+    uint64_t _currentSize = 0;
+    uint64_t _cachePages = default_cache_pages;
+    uint64_t _tick = 0;
+    uint64_t _decompressions = 0;
+    State _state;
+public:
+    explicit TypeStore(Allocator* allocator = nullptr, Codec::type codec = Codec::LZ4)
+        :_data(data_chunk_size, false, allocator), _state{codec, 0, 0, 0}
+    {
+        if (!codecAvailable(codec))
+        {
+            throw std::invalid_argument("codec " + std::to_string(codec) + " is not available in this build");
+        }
+    }
+    uint64_t put(ByteBuffer& value) override
+    {
+        ViewByteBuffer view(value);
+        return put(view);
+    }
+    ByteBuffer get(uint64_t offset, uint64_t type_size) override
+    {
+        return ByteBuffer(getView(offset, type_size));
+    }
+    uint64_t put(ViewByteBuffer& value) override
+    {
+        if (_open.size() > 0 && _open.size() + value._size > page_size)
+        {
+            seal();
+        }
+        if (_open.size() + value._size > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::length_error("value too large for a compressed page");
+        }
+        uint64_t position = _open.size();
+        _positions.push_back(static_cast<uint32_t>(position));
+        _open.resize(position + value._size);
+        if (value._size > 0)
+        {
+            memcpy(_open.data() + position, value._data, value._size);
+        }
+        _state.rawBytes += value._size;
+        return _state.rows++;
+    }
+    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    {
+        if (offset < _currentFirst || offset >= _currentEnd)
+        {
+            if (offset >= _state.openFirst)
+            {
+                uint64_t end = offset + 1 < _state.rows ? _positions[offset + 1] : _open.size();
+                return ViewByteBuffer(end - _positions[offset], _open.data() + _positions[offset]);
+            }
+            uint64_t page = pageOf(offset);
+            _current = pageData(page);
+            _currentFirst = _pages[page].firstRow;
+            _currentEnd = page + 1 < _pages.size() ? _pages[page + 1].firstRow : _state.openFirst;
+            _currentSize = _pages[page].rawSize;
+        }
+        uint64_t end = offset + 1 < _currentEnd ? _positions[offset + 1] : _currentSize;
+        return ViewByteBuffer(end - _positions[offset], _current + _positions[offset]);
+    }
+    inline void setCachePages(uint64_t pages)
+    {
+        _cachePages = pages > 0 ? pages : 1;
+        _cache.clear();
+        _currentEnd = 0;
+    }
+    inline Codec::type codec()
+    {
+        return static_cast<Codec::type>(_state.codec);
+    }
+    inline uint64_t pageCount()
+    {
+        return _pages.size();
+    }
+    // Pages decompressed so far, i.e. cache misses.
+    inline uint64_t decompressions()
+    {
+        return _decompressions;
+    }
+    // Bytes of the values before compression.
+    inline uint64_t rawBytes()
+    {
+        return _state.rawBytes;
+    }
+    inline uint64_t size()
+    {
+        return _state.rows;
+    }
+    inline uint64_t overhead()
+    {
+        uint64_t cached = 0;
+        for(CachedPage& page : _cache)
+        {
+            cached += page.data.capacity();
+        }
+        return _pages.capacity() * sizeof(Page) + _positions.capacity() * sizeof(uint32_t)
+            + _open.capacity() + _scratch.capacity() + cached;
+    }
+    inline void save(ColumnWriter& writer)
+    {
+        writer.section(reinterpret_cast<const char*>(&_state), sizeof(_state));
+        writer.section(_data);
+        writer.section(_pages);
+        writer.section(_positions);
+        writer.section(_open);
+    }
+    inline void load(ColumnReader& reader)
+    {
+        Section meta = reader.next();
+        if (meta.size != sizeof(State))
+        {
+            throw std::runtime_error("invalid compressed page section");
+        }
+        memcpy(&_state, meta.data, sizeof(State));
+        if (!codecAvailable(codec()))
+        {
+            throw std::runtime_error("codec " + std::to_string(_state.codec) + " is not available in this build");
+        }
+        reader.next(_data);
+        reader.next(_pages);
+        reader.next(_positions);
+        reader.next(_open);
+        _cache.clear();
+        _currentEnd = 0;
+    }
+private:
+    inline uint64_t pageOf(uint64_t row)
+    {
+        uint64_t low = 0;
+        uint64_t high = _pages.size();
+        while(high - low > 1)
+        {
+            uint64_t middle = (low + high) / 2;
+            if (_pages[middle].firstRow <= row)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return low;
+    }
+    inline const char* pageData(uint64_t page)
+    {
+        CachedPage* victim = nullptr;
+        for(CachedPage& cached : _cache)
+        {
+            if (cached.page == page)
+            {
+                cached.used = ++_tick;
+                return cached.data.data();
+            }
+            if (victim == nullptr || cached.used < victim->used)
+            {
+                victim = &cached;
+            }
+        }
+        if (_cache.size() < _cachePages)
+        {
+            _cache.push_back(CachedPage{page, 0, std::vector<char>()});
+            victim = &_cache.back();
+        }
+
+        const Page& descriptor = _pages[page];
+        victim->page = page;
+        victim->used = ++_tick;
+        victim->data.resize(descriptor.rawSize);
+        decompress(static_cast<Codec::type>(descriptor.codec), _data.get(descriptor.offset), descriptor.size,
+                   victim->data.data(), descriptor.rawSize);
+        _decompressions++;
+        return victim->data.data();
+    }
+    // Compresses the open page; pages that do not shrink are kept as they are.
+    inline void seal()
+    {
+        uint64_t rawSize = _open.size();
+        Codec::type codec = this->codec();
+        _scratch.resize(compressBound(codec, rawSize));
+        uint64_t size = compress(codec, _open.data(), rawSize, _scratch.data());
+        const char* data = _scratch.data();
+        if (size >= rawSize)
+        {
+            codec = Codec::NONE;
+            size = rawSize;
+            data = _open.data();
+        }
+        uint64_t offset = _data.emplace_back(size, data);
+        _pages.push_back(Page{offset, size, rawSize, _state.openFirst, static_cast<uint64_t>(codec)});
+        _state.openFirst = _state.rows;
+        _open.resize(0);
+    }
+};
+
+template<typename T, typename U>
+class TypedColumn: public Column
+{
+private:
+    T _encoding;
+    typename U::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<T> _store;
+    ZoneMap<U> _zones;
+public:
+    explicit TypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~TypedColumn() {}
+    void put(ByteBuffer& value) override
+    {
+        _store.put(value);
+        _zones.add(*reinterpret_cast<const typename U::c_type*>(value._data));
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        _store.put(value);
+        _zones.add(*reinterpret_cast<const typename U::c_type*>(value._data));
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+            _zones.add(*reinterpret_cast<const typename U::c_type*>(values[i]._data));
+        }
+    }
+    void putBatch(const char* data, uint64_t count) override
+    {
+        _zones.add(reinterpret_cast<const typename U::c_type*>(data), count);
+        if constexpr (std::is_same<T, PlainStore>::value)
+        {
+            ViewByteBuffer values(count * sizeof(_type), data);
+            _store.append(values);
+            return;
+        }
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            ViewByteBuffer value(sizeof(_type), data + i * sizeof(_type));
+            _store.put(value);
+        }
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.get(offset, sizeof(_type));
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.getView(offset, sizeof(_type));
+    }
+    ViewByteBuffer decodeView(uint64_t position, char* buffer) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.decodeView(offset, sizeof(_type), buffer);
+    }
+    inline uint64_t chunkCount()
+    {
+        return _store.chunkCount();
+    }
+    inline ColumnChunk<U> chunk(uint64_t index)
+    {
+        ArrayChunk chunk = _store.chunk(index);
+        return ColumnChunk<U>{reinterpret_cast<const typename U::c_type*>(chunk.data), chunk.offset / sizeof(_type), chunk.size / sizeof(_type)};
+    }
+    inline TypeStore<T>& store()
+    {
+        return _store;
+    }
+    inline ZoneMap<U>& zones()
+    {
+        return _zones;
+    }
+    uint64_t size() override
+    {
+        return std::is_same<T, PlainStore>::value ? _store.size() / sizeof(_type) : _store.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _zones.overhead();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{U::type_num, T::encoding, 0, 0, size()});
+        _store.save(writer);
+        writer.section(_zones);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_zones);
+    }
+};
+
+template<typename T>
+class TypedColumn<T, StringType>: public Column
+{
+private:
+    T _encoding;
+    typename StringType::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<T> _store;
+    MappableVector<uint64_t> _offsets;
+public:
+    explicit TypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~TypedColumn() {}
+    void put(ByteBuffer& value) override
+    {
+        ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
+        _store.reserve(sizeof(uint64_t) + value._size);
+        uint64_t offset = _store.put(value_size);
+        _store.put(value);
+
+        _offsets.push_back(offset);
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
+        _store.reserve(sizeof(uint64_t) + value._size);
+        uint64_t offset = _store.put(value_size);
+        _store.put(value);
+
+        _offsets.push_back(offset);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&values[i]._size));
+            _store.reserve(sizeof(uint64_t) + values[i]._size);
+            uint64_t offset = _store.put(value_size);
+            _store.put(values[i]);
+
+            _offsets.push_back(offset);
+        }
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        uint64_t offset = _offsets[position];
+
+        ViewByteBuffer value_size = _store.get(offset, sizeof(uint64_t));
+        uint64_t size = *reinterpret_cast<uint64_t*>(value_size._data);
+
+        ByteBuffer value = _store.get(offset + sizeof(uint64_t), size);
+
+        return value;
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        uint64_t offset = _offsets[position];
+
+        ViewByteBuffer value_size = _store.getView(offset, sizeof(uint64_t));
+        uint64_t size = *reinterpret_cast<uint64_t*>(value_size._data);
+
+        ViewByteBuffer value = _store.getView(offset + sizeof(uint64_t), size);
+
+        return value;
+    }
+    uint64_t size() override
+    {
+        return _offsets.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _offsets.capacity() * sizeof(uint64_t);
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, T::encoding, 0, 0, _offsets.size()});
+        _store.save(writer);
+        writer.section(_offsets);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_offsets);
+    }
+};
+
+template<>
+class TypedColumn<DictStore, StringType>: public Column
+{
+private:
+    DictStore _encoding;
+    typename StringType::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<DictStore> _store;
+public:
+    explicit TypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~TypedColumn() {}
+    void put(ByteBuffer& value) override
+    {
+        _store.put(value);
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        _store.put(value);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        ByteBuffer value = _store.get(position, sizeof(ByteBuffer));
+
+        return value;
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        ViewByteBuffer value = _store.getView(position, sizeof(ByteBuffer));
+
+        return value;
+    }
+    inline TypeStore<DictStore>& dictionary()
+    {
+        return _store;
+    }
+    uint64_t size() override
+    {
+        return _store.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::DICTIONARY, 0, 0, _store.size()});
+        _store.save(writer);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+    }
+};
+
+template<typename T, typename U>
+class NullableTypedColumn: public Column, public IsNullable
+{
+private:
+    T _encoding;
+    typename U::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<T> _store;
+    ZoneMap<U> _zones;
+public:
+    explicit NullableTypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~NullableTypedColumn() {}
+    void put(ByteBuffer& value) override
+    {
+        _store.put(value);
+        _zones.add(*reinterpret_cast<const typename U::c_type*>(value._data));
+        _validity.push_back(true);
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        _store.put(value);
+        _zones.add(*reinterpret_cast<const typename U::c_type*>(value._data));
+        _validity.push_back(true);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+            _zones.add(*reinterpret_cast<const typename U::c_type*>(values[i]._data));
+        }
+        _validity.append(count, true);
+    }
+    void putBatch(const char* data, uint64_t count) override
+    {
+        _zones.add(reinterpret_cast<const typename U::c_type*>(data), count);
+        _validity.append(count, true);
+        if constexpr (std::is_same<T, PlainStore>::value)
+        {
+            ViewByteBuffer values(count * sizeof(_type), data);
+            _store.append(values);
+            return;
+        }
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            ViewByteBuffer value(sizeof(_type), data + i * sizeof(_type));
+            _store.put(value);
+        }
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.get(offset, sizeof(_type));
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.getView(offset, sizeof(_type));
+    }
+    ViewByteBuffer decodeView(uint64_t position, char* buffer) override
+    {
+        uint64_t offset = std::is_same<T, PlainStore>::value ? position * sizeof(_type) : position;
+        return _store.decodeView(offset, sizeof(_type), buffer);
+    }
+    inline uint64_t chunkCount()
+    {
+        return _store.chunkCount();
+    }
+    inline ColumnChunk<U> chunk(uint64_t index)
+    {
+        ArrayChunk chunk = _store.chunk(index);
+        return ColumnChunk<U>{reinterpret_cast<const typename U::c_type*>(chunk.data), chunk.offset / sizeof(_type), chunk.size / sizeof(_type)};
+    }
+    inline TypeStore<T>& store()
+    {
+        return _store;
+    }
+    inline ZoneMap<U>& zones()
+    {
+        return _zones;
+    }
+    uint64_t size() override
+    {
+        return std::is_same<T, PlainStore>::value ? _store.size() / sizeof(_type) : _store.size();
+    }
+    // Null rows hold a zeroed value, or repeat the last one for run and delta stores, so that store
+    // positions match rows.
+    void putNull() override
+    {
+        if constexpr (std::is_same<T, RleStore>::value || std::is_same<T, DeltaStore>::value)
+        {
+            if (_store.size() > 0)
+            {
+                _store.extend(1);
+                _zones.addNull();
+                _validity.push_back(false);
+                return;
+            }
+        }
+        typename U::c_type zero = typename U::c_type();
+        ViewByteBuffer value(sizeof(zero), reinterpret_cast<char*>(&zero));
+        _store.put(value);
+        _zones.addNull();
+        _validity.push_back(false);
+    }
+    bool getNull(uint64_t position) override
+    {
+        return _validity.isNull(position);
     }
-    ViewByteBuffer getView(uint64_t offset, uint64_t type_size) override
+    inline const ValidityBitmap& validity()
     {
-        ViewByteBuffer buffer(*_position.at(offset));
-        return buffer;
+        return _validity;
     }
-};
-
-template<typename T, typename U>
-class TypedColumn: public Column
-{
-private:
-    T _encoding;
-    typename U::c_type _type;
-    TypeStore<T> _store;
-public:
-    explicit TypedColumn() {}
-    ~TypedColumn() {}
-    void put(ByteBuffer& value) override
+    uint64_t memoryUsage() override
     {
-        _store.put(value);
+        return _memory.allocated() + _store.overhead() + _zones.overhead() + _validity.capacity();
     }
-    void put(ViewByteBuffer& value) override
+    inline MemoryTracker& memory()
     {
-        _store.put(value);
+        return _memory;
     }
-    ByteBuffer get(uint64_t position) override
+    void save(ColumnWriter& writer) override
     {
-        uint64_t offset = position * sizeof(_type);
-        return _store.get(offset, sizeof(_type));
+        writer.begin(ColumnDescriptor{U::type_num, T::encoding, 1, 0, size()});
+        _store.save(writer);
+        writer.section(_zones);
+        writer.section(_validity);
+        writer.end();
     }
-    ViewByteBuffer getView(uint64_t position) override
+    void load(ColumnReader& reader) override
     {
-        uint64_t offset = position * sizeof(_type);
-        return _store.getView(offset, sizeof(_type));
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_zones);
+        reader.next(_validity);
     }
 };
 
 template<typename T>
-class TypedColumn<T, StringType>: public Column
+class NullableTypedColumn<T, StringType>: public Column, public IsNullable
 {
 private:
     T _encoding;
     typename StringType::c_type _type;
+    MemoryTracker _memory;
     TypeStore<T> _store;
-    std::vector<uint64_t> _offsets;
+    MappableVector<uint64_t> _offsets;
 public:
-    explicit TypedColumn() {}
-    ~TypedColumn() {}
+    explicit NullableTypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~NullableTypedColumn() {}
     void put(ByteBuffer& value) override
     {
         ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
+        _store.reserve(sizeof(uint64_t) + value._size);
         uint64_t offset = _store.put(value_size);
         _store.put(value);
 
-        _offsets.emplace_back(offset);
+        _offsets.push_back(offset);
+        _validity.push_back(true);
     }
     void put(ViewByteBuffer& value) override
     {
         ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
+        _store.reserve(sizeof(uint64_t) + value._size);
         uint64_t offset = _store.put(value_size);
         _store.put(value);
 
-        _offsets.emplace_back(offset);
+        _offsets.push_back(offset);
+        _validity.push_back(true);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&values[i]._size));
+            _store.reserve(sizeof(uint64_t) + values[i]._size);
+            uint64_t offset = _store.put(value_size);
+            _store.put(values[i]);
+
+            _offsets.push_back(offset);
+        }
+        _validity.append(count, true);
     }
     ByteBuffer get(uint64_t position) override
     {
@@ -217,59 +1699,151 @@ public:
 
         return value;
     }
+    // Null rows hold an empty string so that offsets stay indexed by row.
+    void putNull() override
+    {
+        uint64_t size = 0;
+        ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&size));
+        uint64_t offset = _store.put(value_size);
+
+        _offsets.push_back(offset);
+        _validity.push_back(false);
+    }
+    bool getNull(uint64_t position) override
+    {
+        return _validity.isNull(position);
+    }
+    inline const ValidityBitmap& validity()
+    {
+        return _validity;
+    }
+    uint64_t size() override
+    {
+        return _offsets.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _offsets.capacity() * sizeof(uint64_t) + _validity.capacity();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, T::encoding, 1, 0, _offsets.size()});
+        _store.save(writer);
+        writer.section(_offsets);
+        writer.section(_validity);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_offsets);
+        reader.next(_validity);
+    }
 };
 
 template<>
-class TypedColumn<DictStore, StringType>: public Column
+class NullableTypedColumn<DictStore, StringType>: public Column, public IsNullable
 {
 private:
     DictStore _encoding;
     typename StringType::c_type _type;
+    MemoryTracker _memory;
     TypeStore<DictStore> _store;
-    std::vector<uint64_t> _offsets;
 public:
-    explicit TypedColumn() {}
-    ~TypedColumn() {}
+    explicit NullableTypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~NullableTypedColumn() {}
     void put(ByteBuffer& value) override
     {
-        uint64_t offset = _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _store.put(value);
+        _validity.push_back(true);
     }
     void put(ViewByteBuffer& value) override
     {
-        uint64_t offset = _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _store.put(value);
+        _validity.push_back(true);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
+        _validity.append(count, true);
     }
     ByteBuffer get(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ByteBuffer value = _store.get(offset, sizeof(ByteBuffer));
+        ByteBuffer value = _store.get(position, sizeof(ByteBuffer));
 
         return value;
     }
     ViewByteBuffer getView(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ViewByteBuffer value = _store.getView(offset, sizeof(ByteBuffer));
+        ViewByteBuffer value = _store.getView(position, sizeof(ByteBuffer));
 
         return value;
     }
+    inline TypeStore<DictStore>& dictionary()
+    {
+        return _store;
+    }
+    uint64_t size() override
+    {
+        return _store.size();
+    }
+    // Null rows take the code of the empty string so that codes stay indexed by row.
+    void putNull() override
+    {
+        ViewByteBuffer value(0, nullptr);
+        _store.put(value);
+        _validity.push_back(false);
+    }
+    bool getNull(uint64_t position) override
+    {
+        return _validity.isNull(position);
+    }
+    inline const ValidityBitmap& validity()
+    {
+        return _validity;
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _validity.capacity();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::DICTIONARY, 1, 0, _store.size()});
+        _store.save(writer);
+        writer.section(_validity);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_validity);
+    }
 };
 
-template<typename T, typename U>
-class NullableTypedColumn: public Column, IsNullable
+template<>
+class TypedColumn<RleStore, StringType>: public Column
 {
 private:
-    T _encoding;
-    typename U::c_type _type;
-    TypeStore<T> _store;
+    RleStore _encoding;
+    typename StringType::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<RleStore> _store;
 public:
-    explicit NullableTypedColumn() {}
-    ~NullableTypedColumn() {}
+    explicit TypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
+    ~TypedColumn() {}
     void put(ByteBuffer& value) override
     {
         _store.put(value);
@@ -278,132 +1852,406 @@ public:
     {
         _store.put(value);
     }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
+    }
     ByteBuffer get(uint64_t position) override
     {
-        uint64_t offset = position * sizeof(_type);
-        return _store.get(offset, sizeof(_type));
+        ByteBuffer value = _store.get(position, sizeof(ByteBuffer));
+
+        return value;
     }
     ViewByteBuffer getView(uint64_t position) override
     {
-        uint64_t offset = position * sizeof(_type);
-        return _store.getView(offset, sizeof(_type));
+        ViewByteBuffer value = _store.getView(position, sizeof(ByteBuffer));
+
+        return value;
     }
-    void putNull(bool value) override
+    inline TypeStore<RleStore>& runs()
     {
-        _nulls.push_back(value);
+        return _store;
     }
-    bool getNull(uint64_t position) override
+    uint64_t size() override
+    {
+        return _store.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::RLE, 0, 0, _store.size()});
+        _store.save(writer);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
     {
-        return _nulls.at(position);
+        _owner = reader.owner();
+        _store.load(reader);
     }
 };
 
-template<typename T>
-class NullableTypedColumn<T, StringType>: public Column, IsNullable
+template<>
+class NullableTypedColumn<RleStore, StringType>: public Column, public IsNullable
 {
 private:
-    T _encoding;
+    RleStore _encoding;
     typename StringType::c_type _type;
-    TypeStore<T> _store;
-    std::vector<uint64_t> _offsets;
+    MemoryTracker _memory;
+    TypeStore<RleStore> _store;
 public:
-    explicit NullableTypedColumn() {}
+    explicit NullableTypedColumn(Allocator* allocator = nullptr):_memory(allocator), _store(&_memory) {}
     ~NullableTypedColumn() {}
     void put(ByteBuffer& value) override
     {
-        ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
-        uint64_t offset = _store.put(value_size);
         _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _validity.push_back(true);
     }
     void put(ViewByteBuffer& value) override
     {
-        ViewByteBuffer value_size(sizeof(uint64_t), reinterpret_cast<char*>(&value._size));
-        uint64_t offset = _store.put(value_size);
         _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _validity.push_back(true);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
+        _validity.append(count, true);
     }
     ByteBuffer get(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ViewByteBuffer value_size = _store.get(offset, sizeof(uint64_t));
-        uint64_t size = *reinterpret_cast<uint64_t*>(value_size._data);
-
-        ByteBuffer value = _store.get(offset + sizeof(uint64_t), size);
+        ByteBuffer value = _store.get(position, sizeof(ByteBuffer));
 
         return value;
     }
     ViewByteBuffer getView(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ViewByteBuffer value_size = _store.getView(offset, sizeof(uint64_t));
-        uint64_t size = *reinterpret_cast<uint64_t*>(value_size._data);
-
-        ViewByteBuffer value = _store.getView(offset + sizeof(uint64_t), size);
+        ViewByteBuffer value = _store.getView(position, sizeof(ByteBuffer));
 
         return value;
     }
-    void putNull(bool value) override
+    inline TypeStore<RleStore>& runs()
+    {
+        return _store;
+    }
+    uint64_t size() override
+    {
+        return _store.size();
+    }
+    // Null rows extend the last run, or start one of the empty string, so that runs stay indexed by row.
+    void putNull() override
     {
-        _nulls.push_back(value);
+        if (_store.runCount() > 0)
+        {
+            _store.extend(1);
+        }
+        else
+        {
+            ViewByteBuffer value(0, nullptr);
+            _store.put(value);
+        }
+        _validity.push_back(false);
     }
     bool getNull(uint64_t position) override
     {
-        return _nulls.at(position);
+        return _validity.isNull(position);
+    }
+    inline const ValidityBitmap& validity()
+    {
+        return _validity;
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _validity.capacity();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::RLE, 1, 0, _store.size()});
+        _store.save(writer);
+        writer.section(_validity);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_validity);
     }
 };
 
 template<>
-class NullableTypedColumn<DictStore, StringType>: public Column, IsNullable
+class TypedColumn<CompressedStore, StringType>: public Column
 {
 private:
-    DictStore _encoding;
+    CompressedStore _encoding;
     typename StringType::c_type _type;
-    TypeStore<DictStore> _store;
-    std::vector<uint64_t> _offsets;
+    MemoryTracker _memory;
+    TypeStore<CompressedStore> _store;
 public:
-    explicit NullableTypedColumn() {}
-    ~NullableTypedColumn() {}
+    explicit TypedColumn(Allocator* allocator = nullptr, Codec::type codec = Codec::LZ4):_memory(allocator), _store(&_memory, codec) {}
+    ~TypedColumn() {}
     void put(ByteBuffer& value) override
     {
-        uint64_t offset = _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _store.put(value);
     }
     void put(ViewByteBuffer& value) override
     {
-        uint64_t offset = _store.put(value);
-
-        _offsets.emplace_back(offset);
+        _store.put(value);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
     }
     ByteBuffer get(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ByteBuffer value = _store.get(offset, sizeof(ByteBuffer));
-
-        return value;
+        return _store.get(position, sizeof(ByteBuffer));
     }
     ViewByteBuffer getView(uint64_t position) override
     {
-        uint64_t offset = _offsets[position];
-
-        ViewByteBuffer value = _store.getView(offset, sizeof(ByteBuffer));
+        return _store.getView(position, sizeof(ByteBuffer));
+    }
+    inline TypeStore<CompressedStore>& store()
+    {
+        return _store;
+    }
+    uint64_t size() override
+    {
+        return _store.size();
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::COMPRESSED, 0, 0, _store.size()});
+        _store.save(writer);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+    }
+};
 
-        return value;
+template<>
+class NullableTypedColumn<CompressedStore, StringType>: public Column, public IsNullable
+{
+private:
+    CompressedStore _encoding;
+    typename StringType::c_type _type;
+    MemoryTracker _memory;
+    TypeStore<CompressedStore> _store;
+public:
+    explicit NullableTypedColumn(Allocator* allocator = nullptr, Codec::type codec = Codec::LZ4):_memory(allocator), _store(&_memory, codec) {}
+    ~NullableTypedColumn() {}
+    void put(ByteBuffer& value) override
+    {
+        _store.put(value);
+        _validity.push_back(true);
+    }
+    void put(ViewByteBuffer& value) override
+    {
+        _store.put(value);
+        _validity.push_back(true);
+    }
+    void putBatch(ViewByteBuffer* values, uint64_t count) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            _store.put(values[i]);
+        }
+        _validity.append(count, true);
+    }
+    ByteBuffer get(uint64_t position) override
+    {
+        return _store.get(position, sizeof(ByteBuffer));
+    }
+    ViewByteBuffer getView(uint64_t position) override
+    {
+        return _store.getView(position, sizeof(ByteBuffer));
+    }
+    inline TypeStore<CompressedStore>& store()
+    {
+        return _store;
+    }
+    uint64_t size() override
+    {
+        return _store.size();
     }
-    void putNull(bool value) override
+    // Null rows hold an empty string.
+    void putNull() override
     {
-        _nulls.push_back(value);
+        ViewByteBuffer value(0, nullptr);
+        _store.put(value);
+        _validity.push_back(false);
     }
     bool getNull(uint64_t position) override
     {
-        return _nulls.at(position);
+        return _validity.isNull(position);
+    }
+    inline const ValidityBitmap& validity()
+    {
+        return _validity;
+    }
+    uint64_t memoryUsage() override
+    {
+        return _memory.allocated() + _store.overhead() + _validity.capacity();
+    }
+    inline MemoryTracker& memory()
+    {
+        return _memory;
+    }
+    void save(ColumnWriter& writer) override
+    {
+        writer.begin(ColumnDescriptor{Type::STRING, Encoding::COMPRESSED, 1, 0, _store.size()});
+        _store.save(writer);
+        writer.section(_validity);
+        writer.end();
+    }
+    void load(ColumnReader& reader) override
+    {
+        _owner = reader.owner();
+        _store.load(reader);
+        reader.next(_validity);
     }
 };
 
+template<typename T, typename U>
+inline std::unique_ptr<Column> makeTypedColumn(bool nullable, Allocator* allocator)
+{
+    if (nullable)
+    {
+        return std::unique_ptr<Column>(new NullableTypedColumn<T, U>(allocator));
+    }
+    return std::unique_ptr<Column>(new TypedColumn<T, U>(allocator));
+}
+
+template<typename T>
+inline std::unique_ptr<Column> makeColumn(Type::type type, bool nullable, Allocator* allocator)
+{
+    switch(type)
+    {
+    case Type::UINT8: return makeTypedColumn<T, UInt8Type>(nullable, allocator);
+    case Type::INT8: return makeTypedColumn<T, Int8Type>(nullable, allocator);
+    case Type::UINT16: return makeTypedColumn<T, UInt16Type>(nullable, allocator);
+    case Type::INT16: return makeTypedColumn<T, Int16Type>(nullable, allocator);
+    case Type::UINT32: return makeTypedColumn<T, UInt32Type>(nullable, allocator);
+    case Type::INT32: return makeTypedColumn<T, Int32Type>(nullable, allocator);
+    case Type::UINT64: return makeTypedColumn<T, UInt64Type>(nullable, allocator);
+    case Type::INT64: return makeTypedColumn<T, Int64Type>(nullable, allocator);
+    case Type::FLOAT: return makeTypedColumn<T, FloatType>(nullable, allocator);
+    case Type::DOUBLE: return makeTypedColumn<T, DoubleType>(nullable, allocator);
+    case Type::STRING: return makeTypedColumn<T, StringType>(nullable, allocator);
+    }
+    throw std::invalid_argument("unknown type " + std::to_string(type));
+}
+
+inline std::unique_ptr<Column> makeColumn(Type::type type, Encoding::type encoding, bool nullable, Allocator* allocator = nullptr)
+{
+    switch(encoding)
+    {
+    case Encoding::PLAIN: return makeColumn<PlainStore>(type, nullable, allocator);
+    case Encoding::DICTIONARY: return makeColumn<DictStore>(type, nullable, allocator);
+    case Encoding::RLE: return makeColumn<RleStore>(type, nullable, allocator);
+    case Encoding::BITPACKED:
+        switch(type)
+        {
+        case Type::UINT8: return makeTypedColumn<BitPackedStore, UInt8Type>(nullable, allocator);
+        case Type::INT8: return makeTypedColumn<BitPackedStore, Int8Type>(nullable, allocator);
+        case Type::UINT16: return makeTypedColumn<BitPackedStore, UInt16Type>(nullable, allocator);
+        case Type::INT16: return makeTypedColumn<BitPackedStore, Int16Type>(nullable, allocator);
+        case Type::UINT32: return makeTypedColumn<BitPackedStore, UInt32Type>(nullable, allocator);
+        case Type::INT32: return makeTypedColumn<BitPackedStore, Int32Type>(nullable, allocator);
+        case Type::UINT64: return makeTypedColumn<BitPackedStore, UInt64Type>(nullable, allocator);
+        case Type::INT64: return makeTypedColumn<BitPackedStore, Int64Type>(nullable, allocator);
+        default: throw std::invalid_argument("bit packing supports integer types only");
+        }
+    case Encoding::DELTA:
+        if (type != Type::INT64)
+        {
+            throw std::invalid_argument("delta coding supports INT64 only");
+        }
+        return makeTypedColumn<DeltaStore, Int64Type>(nullable, allocator);
+    case Encoding::COMPRESSED:
+        if (type != Type::STRING)
+        {
+            throw std::invalid_argument("page compression supports STRING only");
+        }
+        return makeTypedColumn<CompressedStore, StringType>(nullable, allocator);
+    case Encoding::ADAPTIVE:
+        throw std::invalid_argument("adaptive columns are made by AdaptiveColumn");
+    }
+    throw std::invalid_argument("unknown encoding " + std::to_string(encoding));
+}
+
+// Rows [begin, begin + count) of a plain fixed width column: a pointer into the column when they
+// sit in one chunk, else a copy in buffer.
+template<typename U, typename C>
+inline const typename U::c_type* plainRows(C& column, uint64_t begin, uint64_t count, typename U::c_type* buffer)
+{
+    uint64_t perChunk = column.chunkCount() > 1 ? column.chunk(0).size : column.size();
+    uint64_t index = begin / perChunk;
+    ColumnChunk<U> chunk = column.chunk(index);
+    if (begin + count <= chunk.offset + chunk.size)
+    {
+        return chunk.data + (begin - chunk.offset);
+    }
+    for(uint64_t copied = 0; copied < count;)
+    {
+        chunk = column.chunk((begin + copied) / perChunk);
+        uint64_t offset = begin + copied - chunk.offset;
+        uint64_t rows = chunk.size - offset < count - copied ? chunk.size - offset : count - copied;
+        memcpy(buffer + copied, chunk.data + offset, rows * sizeof(typename U::c_type));
+        copied += rows;
+    }
+    return buffer;
+}
+
+// Appends the values of source at rows to target. A null value, or a row of ~0 standing for no row,
+// appends a null, which needs a nullable target.
+inline void gather(Column& source, const uint64_t* rows, uint64_t count, Column& target)
+{
+    IsNullable* nullable = dynamic_cast<IsNullable*>(&target);
+    IsNullable* nulls = dynamic_cast<IsNullable*>(&source);
+    uint64_t buffer;
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        if (rows[i] == ~uint64_t(0) || (nulls != nullptr && nulls->getNull(rows[i])))
+        {
+            if (nullable == nullptr)
+            {
+                throw std::logic_error("gathering a null into a column that is not nullable");
+            }
+            nullable->putNull();
+            continue;
+        }
+        ViewByteBuffer value = source.decodeView(rows[i], reinterpret_cast<char*>(&buffer));
+        target.put(value);
+    }
+}
+
 #endif // COLUMN_H
@@ -0,0 +1,363 @@
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <stdexcept>
+#include <memory.h>
+
+#include "column.h"
+#include "adaptive.h"
+#include "hash.h"
+#include "mappedfile.h"
+
+// Layout: a header padded to one page, then every section starting on a page boundary, then the
+// directory. The directory holds, per column, its descriptor followed by one SectionDescriptor per
+// section, each followed by the checksums of its pages.
+struct ColumnFileHeader
+{
+    static constexpr char magic_value[8] = {'C', 'O', 'L', 'F', 'I', 'L', 'E', '1'};
+    static constexpr uint64_t current_version = 1;
+
+    char magic[8];
+    uint64_t version;
+    uint64_t columns;
+    uint64_t directoryOffset;
+    uint64_t directorySize;
+    uint64_t directoryChecksum;
+};
+
+struct SectionDescriptor
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t chunkSize;
+    uint64_t pageSize;
+    uint64_t pages;
+};
+
+class ColumnFileWriter: public ColumnWriter
+{
+public:
+    static constexpr uint64_t alignment = 4096;
+    static constexpr uint64_t page_size = 1024 * 1024;
+private:
+    std::string _path;
+    FILE* _file = nullptr;
+    uint64_t _position = 0;
+    uint64_t _columns = 0;
+    std::vector<char> _directory;
+    std::vector<char> _page;
+    ColumnDescriptor _descriptor;
+    std::vector<SectionDescriptor> _sections;
+    std::vector<std::vector<uint64_t>> _checksums;
+public:
+    explicit ColumnFileWriter(const std::string& path):_path(path)
+    {
+        _file = fopen(path.c_str(), "wb");
+        if (_file == nullptr)
+        {
+            throw std::runtime_error("cannot create " + path);
+        }
+        _page.reserve(page_size);
+        std::vector<char> header(alignment, 0);
+        output(header.data(), header.size());
+    }
+    ColumnFileWriter(const ColumnFileWriter&) = delete;
+    ColumnFileWriter& operator=(const ColumnFileWriter&) = delete;
+    ~ColumnFileWriter()
+    {
+        if (_file != nullptr)
+        {
+            fclose(_file);
+            _file = nullptr;
+        }
+    }
+    inline void add(Column& column)
+    {
+        column.save(*this);
+    }
+    void begin(const ColumnDescriptor& descriptor) override
+    {
+        _descriptor = descriptor;
+        _sections.clear();
+        _checksums.clear();
+    }
+    void beginSection(uint64_t chunkSize) override
+    {
+        _sections.push_back(SectionDescriptor{_position, 0, chunkSize, page_size, 0});
+        _checksums.emplace_back();
+        _page.clear();
+    }
+    void write(const char* data, uint64_t size) override
+    {
+        _sections.back().size += size;
+        while(size > 0)
+        {
+            uint64_t bytes = page_size - _page.size() < size ? page_size - _page.size() : size;
+            _page.insert(_page.end(), data, data + bytes);
+            data += bytes;
+            size -= bytes;
+            if (_page.size() == page_size)
+            {
+                flushPage();
+            }
+        }
+    }
+    void endSection() override
+    {
+        if (!_page.empty())
+        {
+            flushPage();
+        }
+        _sections.back().pages = _checksums.back().size();
+        pad(alignment);
+    }
+    void end() override
+    {
+        _descriptor.sections = static_cast<uint32_t>(_sections.size());
+        append(&_descriptor, sizeof(_descriptor));
+        for(uint64_t i = 0; i < _sections.size(); ++i)
+        {
+            append(&_sections[i], sizeof(SectionDescriptor));
+            append(_checksums[i].data(), _checksums[i].size() * sizeof(uint64_t));
+        }
+        _columns++;
+    }
+    // Writes the directory and the header; the file is complete only after close().
+    void close()
+    {
+        ColumnFileHeader header;
+        memcpy(header.magic, ColumnFileHeader::magic_value, sizeof(header.magic));
+        header.version = ColumnFileHeader::current_version;
+        header.columns = _columns;
+        header.directoryOffset = _position;
+        header.directorySize = _directory.size();
+        header.directoryChecksum = hashBytes(_directory.data(), _directory.size());
+
+        output(_directory.data(), _directory.size());
+        if (fseek(_file, 0, SEEK_SET) != 0)
+        {
+            throw std::runtime_error("cannot write " + _path);
+        }
+        output(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (fclose(_file) != 0)
+        {
+            _file = nullptr;
+            throw std::runtime_error("cannot write " + _path);
+        }
+        _file = nullptr;
+    }
+private:
+    inline void append(const void* data, uint64_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        _directory.insert(_directory.end(), bytes, bytes + size);
+    }
+    inline void flushPage()
+    {
+        _checksums.back().push_back(hashBytes(_page.data(), _page.size()));
+        output(_page.data(), _page.size());
+        _page.clear();
+    }
+    inline void pad(uint64_t boundary)
+    {
+        static const char zeros[alignment] = {};
+        uint64_t size = (boundary - _position % boundary) % boundary;
+        output(zeros, size);
+    }
+    inline void output(const char* data, uint64_t size)
+    {
+        if (size > 0 && fwrite(data, 1, size, _file) != size)
+        {
+            throw std::runtime_error("cannot write " + _path);
+        }
+        _position += size;
+    }
+};
+
+// Opens a column file through mmap. Loaded columns are served from the mapping without copying
+// and keep it alive; they are read-only.
+class ColumnFile
+{
+private:
+    struct Entry
+    {
+        ColumnDescriptor descriptor;
+        std::vector<SectionDescriptor> sections;
+        std::vector<const uint64_t*> checksums;
+    };
+
+    class Reader: public ColumnReader
+    {
+    private:
+        ColumnFile& _file;
+        Entry& _entry;
+        uint64_t _next = 0;
+    public:
+        Reader(ColumnFile& file, Entry& entry):_file(file), _entry(entry) {}
+        const ColumnDescriptor& descriptor() override
+        {
+            return _entry.descriptor;
+        }
+        Section next() override
+        {
+            if (_next >= _entry.sections.size())
+            {
+                throw std::runtime_error("column has fewer sections than expected in " + _file._path);
+            }
+            SectionDescriptor& section = _entry.sections[_next++];
+            return Section{_file._mapping->data() + section.offset, section.size, section.chunkSize};
+        }
+        std::shared_ptr<const void> owner() override
+        {
+            return _file._mapping;
+        }
+    };
+
+    std::string _path;
+    std::shared_ptr<MappedFile> _mapping;
+    std::vector<Entry> _entries;
+public:
+    explicit ColumnFile(const std::string& path, bool verify = false)
+        :_path(path), _mapping(std::make_shared<MappedFile>(path, MADV_NORMAL))
+    {
+        const char* data = _mapping->data();
+        uint64_t size = _mapping->size();
+
+        ColumnFileHeader header;
+        if (size < sizeof(header))
+        {
+            corrupt("truncated header");
+        }
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, ColumnFileHeader::magic_value, sizeof(header.magic)) != 0)
+        {
+            corrupt("bad magic");
+        }
+        if (header.version != ColumnFileHeader::current_version)
+        {
+            corrupt("unsupported version " + std::to_string(header.version));
+        }
+        if (header.directoryOffset > size || header.directorySize > size - header.directoryOffset)
+        {
+            corrupt("truncated directory");
+        }
+        const char* directory = data + header.directoryOffset;
+        if (hashBytes(directory, header.directorySize) != header.directoryChecksum)
+        {
+            corrupt("directory checksum mismatch");
+        }
+
+        uint64_t position = 0;
+        for(uint64_t c = 0; c < header.columns; ++c)
+        {
+            Entry entry;
+            read(directory, header.directorySize, position, &entry.descriptor, sizeof(ColumnDescriptor));
+            for(uint32_t s = 0; s < entry.descriptor.sections; ++s)
+            {
+                SectionDescriptor section;
+                read(directory, header.directorySize, position, &section, sizeof(section));
+                if (section.offset > size || section.size > size - section.offset || section.offset % ColumnFileWriter::alignment != 0)
+                {
+                    corrupt("section out of bounds");
+                }
+                if (section.pages * sizeof(uint64_t) > header.directorySize - position)
+                {
+                    corrupt("truncated checksums");
+                }
+                entry.sections.push_back(section);
+                entry.checksums.push_back(reinterpret_cast<const uint64_t*>(directory + position));
+                position += section.pages * sizeof(uint64_t);
+            }
+            _entries.push_back(std::move(entry));
+        }
+
+        if (verify)
+        {
+            this->verify();
+        }
+    }
+    inline uint64_t columnCount() const
+    {
+        return _entries.size();
+    }
+    inline const ColumnDescriptor& descriptor(uint64_t index) const
+    {
+        return _entries.at(index).descriptor;
+    }
+    std::unique_ptr<Column> column(uint64_t index, Allocator* allocator = nullptr)
+    {
+        Entry& entry = _entries.at(index);
+        Type::type type = static_cast<Type::type>(entry.descriptor.type);
+        Encoding::type encoding = static_cast<Encoding::type>(entry.descriptor.encoding);
+        std::unique_ptr<Column> column = encoding == Encoding::ADAPTIVE
+            ? std::unique_ptr<Column>(new AdaptiveColumn(type, entry.descriptor.nullable != 0, AdaptiveColumn::default_group_size,
+                                                         AdaptiveColumn::default_sample_size, allocator))
+            : makeColumn(type, encoding, entry.descriptor.nullable != 0, allocator);
+        Reader reader(*this, entry);
+        column->load(reader);
+        return column;
+    }
+    // Reads every page and compares it against its stored checksum.
+    void verify()
+    {
+        for(Entry& entry : _entries)
+        {
+            for(uint64_t s = 0; s < entry.sections.size(); ++s)
+            {
+                SectionDescriptor& section = entry.sections[s];
+                for(uint64_t p = 0; p < section.pages; ++p)
+                {
+                    uint64_t offset = p * section.pageSize;
+                    uint64_t bytes = section.size - offset < section.pageSize ? section.size - offset : section.pageSize;
+                    uint64_t checksum;
+                    memcpy(&checksum, entry.checksums[s] + p, sizeof(checksum));
+                    if (hashBytes(_mapping->data() + section.offset + offset, bytes) != checksum)
+                    {
+                        corrupt("page checksum mismatch");
+                    }
+                }
+            }
+        }
+    }
+private:
+    inline void read(const char* directory, uint64_t size, uint64_t& position, void* out, uint64_t bytes)
+    {
+        if (bytes > size - position)
+        {
+            corrupt("truncated directory");
+        }
+        memcpy(out, directory + position, bytes);
+        position += bytes;
+    }
+    [[noreturn]] inline void corrupt(const std::string& reason)
+    {
+        throw std::runtime_error("corrupt column file " + _path + ": " + reason);
+    }
+};
+
+inline void saveColumns(const std::string& path, std::vector<std::unique_ptr<Column>>& columns)
+{
+    ColumnFileWriter writer(path);
+    for(std::unique_ptr<Column>& column : columns)
+    {
+        writer.add(*column);
+    }
+    writer.close();
+}
+
+inline std::vector<std::unique_ptr<Column>> loadColumns(const std::string& path, bool verify = false)
+{
+    ColumnFile file(path, verify);
+    std::vector<std::unique_ptr<Column>> columns;
+    for(uint64_t i = 0; i < file.columnCount(); ++i)
+    {
+        columns.push_back(file.column(i));
+    }
+    return columns;
+}
+
+#endif // COLUMNFILE_H
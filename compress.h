@@ -0,0 +1,283 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <string>
+#include <vector>
+#include <memory.h>
+#include <stdexcept>
+#include <stdint.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// LZ4 is built in (block format, greedy matcher); Zstd needs HAVE_ZSTD and libzstd at build time.
+struct Codec
+{
+    enum type
+    {
+        NONE = 0,
+        LZ4 = 1,
+        ZSTD = 2
+    };
+};
+
+namespace Lz4
+{
+    static constexpr uint64_t min_match = 4;
+    static constexpr uint64_t last_literals = 5;
+    static constexpr uint64_t match_limit = 12;
+    static constexpr uint64_t max_offset = 65535;
+    static constexpr uint64_t hash_bits = 12;
+
+    inline uint64_t bound(uint64_t size)
+    {
+        return size + size / 255 + 16;
+    }
+    inline uint32_t read32(const char* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    inline char* writeLength(char* out, uint64_t length)
+    {
+        for(; length >= 255; length -= 255)
+        {
+            *out++ = static_cast<char>(255);
+        }
+        *out++ = static_cast<char>(length);
+        return out;
+    }
+    inline char* writeSequence(char* out, const char* literals, uint64_t literalLength, uint64_t offset, uint64_t matchLength)
+    {
+        char* token = out++;
+        uint8_t high = static_cast<uint8_t>(literalLength < 15 ? literalLength : 15);
+        if (literalLength >= 15)
+        {
+            out = writeLength(out, literalLength - 15);
+        }
+        memcpy(out, literals, literalLength);
+        out += literalLength;
+
+        uint8_t low = 0;
+        if (matchLength > 0)
+        {
+            out[0] = static_cast<char>(offset & 0xff);
+            out[1] = static_cast<char>(offset >> 8);
+            out += 2;
+            uint64_t extra = matchLength - min_match;
+            low = static_cast<uint8_t>(extra < 15 ? extra : 15);
+            if (extra >= 15)
+            {
+                out = writeLength(out, extra - 15);
+            }
+        }
+        *token = static_cast<char>((high << 4) | low);
+        return out;
+    }
+    // Writes at most bound(size) bytes and returns how many.
+    inline uint64_t compress(const char* data, uint64_t size, char* out)
+    {
+        char* start = out;
+        uint64_t anchor = 0;
+        if (size > match_limit)
+        {
+            std::vector<uint32_t> table(uint64_t(1) << hash_bits, 0);
+            uint64_t limit = size - match_limit;
+            uint64_t end = size - last_literals;
+            uint64_t position = 1;
+            while(position <= limit)
+            {
+                uint32_t hash = (read32(data + position) * 2654435761U) >> (32 - hash_bits);
+                uint64_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(position);
+                if (position - candidate > max_offset || read32(data + candidate) != read32(data + position))
+                {
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                while(position > anchor && candidate > 0 && data[position - 1] == data[candidate - 1])
+                {
+                    position--;
+                    candidate--;
+                }
+                uint64_t length = min_match;
+                while(position + length < end && data[candidate + length] == data[position + length])
+                {
+                    length++;
+                }
+                out = writeSequence(out, data + anchor, position - anchor, position - candidate, length);
+                position += length;
+                anchor = position;
+            }
+        }
+        out = writeSequence(out, data + anchor, size - anchor, 0, 0);
+        return static_cast<uint64_t>(out - start);
+    }
+    // Returns false on malformed input or when the output is not exactly size bytes.
+    inline bool decompress(const char* data, uint64_t size, char* out, uint64_t rawSize)
+    {
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+        uint64_t position = 0;
+        uint64_t written = 0;
+        while(position < size)
+        {
+            uint8_t token = in[position++];
+            uint64_t literals = token >> 4;
+            if (literals == 15)
+            {
+                uint8_t next;
+                do {
+                    if (position >= size)
+                    {
+                        return false;
+                    }
+                    next = in[position++];
+                    literals += next;
+                } while(next == 255);
+            }
+            if (literals > size - position || literals > rawSize - written)
+            {
+                return false;
+            }
+            memcpy(out + written, data + position, literals);
+            position += literals;
+            written += literals;
+            if (position == size)
+            {
+                break;
+            }
+
+            if (size - position < 2)
+            {
+                return false;
+            }
+            uint64_t offset = in[position] | (uint64_t(in[position + 1]) << 8);
+            position += 2;
+            if (offset == 0 || offset > written)
+            {
+                return false;
+            }
+            uint64_t length = token & 15;
+            if (length == 15)
+            {
+                uint8_t next;
+                do {
+                    if (position >= size)
+                    {
+                        return false;
+                    }
+                    next = in[position++];
+                    length += next;
+                } while(next == 255);
+            }
+            length += min_match;
+            if (length > rawSize - written)
+            {
+                return false;
+            }
+            if (offset >= length)
+            {
+                memcpy(out + written, out + written - offset, length);
+            }
+            else
+            {
+                for(uint64_t i = 0; i < length; ++i)
+                {
+                    out[written + i] = out[written + i - offset];
+                }
+            }
+            written += length;
+        }
+        return written == rawSize;
+    }
+}
+
+inline bool codecAvailable(Codec::type codec)
+{
+    switch(codec)
+    {
+    case Codec::NONE:
+    case Codec::LZ4:
+        return true;
+    case Codec::ZSTD:
+#ifdef HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+inline uint64_t compressBound(Codec::type codec, uint64_t size)
+{
+    switch(codec)
+    {
+    case Codec::LZ4: return Lz4::bound(size);
+#ifdef HAVE_ZSTD
+    case Codec::ZSTD: return ZSTD_compressBound(size);
+#endif
+    default: return size;
+    }
+}
+
+// Compresses into out, which holds at least compressBound(codec, size) bytes, and returns the size.
+inline uint64_t compress(Codec::type codec, const char* data, uint64_t size, char* out)
+{
+    switch(codec)
+    {
+    case Codec::NONE:
+        memcpy(out, data, size);
+        return size;
+    case Codec::LZ4:
+        return Lz4::compress(data, size, out);
+#ifdef HAVE_ZSTD
+    case Codec::ZSTD:
+    {
+        size_t written = ZSTD_compress(out, ZSTD_compressBound(size), data, size, 3);
+        if (ZSTD_isError(written))
+        {
+            throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(written));
+        }
+        return written;
+    }
+#endif
+    default:
+        throw std::invalid_argument("codec " + std::to_string(codec) + " is not available");
+    }
+}
+
+inline void decompress(Codec::type codec, const char* data, uint64_t size, char* out, uint64_t rawSize)
+{
+    switch(codec)
+    {
+    case Codec::NONE:
+        if (size != rawSize)
+        {
+            throw std::runtime_error("corrupt page");
+        }
+        memcpy(out, data, size);
+        return;
+    case Codec::LZ4:
+        if (!Lz4::decompress(data, size, out, rawSize))
+        {
+            throw std::runtime_error("corrupt lz4 page");
+        }
+        return;
+#ifdef HAVE_ZSTD
+    case Codec::ZSTD:
+        if (ZSTD_decompress(out, rawSize, data, size) != rawSize)
+        {
+            throw std::runtime_error("corrupt zstd page");
+        }
+        return;
+#endif
+    default:
+        throw std::invalid_argument("codec " + std::to_string(codec) + " is not available");
+    }
+}
+
+#endif // COMPRESS_H
@@ -0,0 +1,120 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <vector>
+#include <algorithm>
+#include <experimental/string_view>
+
+#include "bytebuffer.h"
+#include "scanner.h"
+
+inline void split(std::vector<std::experimental::string_view>& results, std::experimental::string_view original, char separator)
+{
+    StructuralScanner scanner(separator);
+    const char* start = original.data();
+
+    scanner.scan(original.data(), original.size(), [&](uint64_t position, bool) {
+        const char* next = original.data() + position;
+        results.emplace_back(start, static_cast<uint64_t>(next - start));
+        start = next + 1;
+        return true;
+    });
+
+    const char* end = original.data() + original.size();
+    results.emplace_back(start, static_cast<uint64_t>(end - start));
+}
+
+class CsvReader
+{
+private:
+    static constexpr uint64_t window_size = 64 * 1024;
+
+    const char* _data = nullptr;
+    const char* _begin = nullptr;
+    const char* _end = nullptr;
+    const char* _scanned = nullptr;
+    std::experimental::string_view _line;
+    StructuralScanner _scanner;
+    std::vector<uint64_t> _marks;
+    uint64_t _mark = 0;
+    std::vector<ViewByteBuffer> _skipped;
+public:
+    CsvReader(const char* data, uint64_t size, char separator = ','):_scanner(separator)
+    {
+        _data = data;
+        _begin = data;
+        _end = data + size;
+        _scanned = data;
+    }
+    inline bool skipLine()
+    {
+        return next(_skipped);
+    }
+    inline bool next(std::vector<ViewByteBuffer>& cells)
+    {
+        cells.clear();
+        if (_begin == _end)
+        {
+            return false;
+        }
+
+        const char* row = _begin;
+        const char* start = _begin;
+        const char* stop = _end;
+        while(true)
+        {
+            if (_mark == _marks.size() && !refill())
+            {
+                cells.emplace_back(static_cast<uint64_t>(_end - start), start);
+                _begin = _end;
+                break;
+            }
+
+            uint64_t mark = _marks[_mark++];
+            const char* next = _data + (mark >> 1);
+            cells.emplace_back(static_cast<uint64_t>(next - start), start);
+            start = next + 1;
+
+            if ((mark & 1) != 0)
+            {
+                stop = next;
+                _begin = start;
+                break;
+            }
+        }
+
+        _line = std::experimental::string_view(row, static_cast<uint64_t>(stop - row));
+
+        return true;
+    }
+    inline std::experimental::string_view line() const
+    {
+        return _line;
+    }
+    inline const char* position() const
+    {
+        return _begin;
+    }
+private:
+    inline bool refill()
+    {
+        _marks.clear();
+        _mark = 0;
+
+        while(_marks.empty() && _scanned != _end)
+        {
+            uint64_t size = static_cast<uint64_t>(_end - _scanned);
+            if (size > window_size)
+            {
+                size = window_size;
+            }
+
+            _scanner.index(_scanned, size, static_cast<uint64_t>(_scanned - _data), _marks);
+            _scanned += size;
+        }
+
+        return !_marks.empty();
+    }
+};
+
+#endif // CSV_H
@@ -0,0 +1,675 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <vector>
+#include <memory>
+#include <memory.h>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "types.h"
+#include "column.h"
+#include "bitmap.h"
+#include "isa.h"
+#include "zonemap.h"
+
+struct CompareOp
+{
+    enum type
+    {
+        EQ = 0,
+        NE = 1,
+        LT = 2,
+        LE = 3,
+        GT = 4,
+        GE = 5,
+        BETWEEN = 6,
+        IN = 7
+    };
+};
+
+template<typename C, int WIDTH>
+struct vector_lanes
+{
+    typedef C type __attribute__((vector_size(WIDTH)));
+    typedef decltype(type() < type()) mask_type;
+};
+
+template<typename T, int OP, int WIDTH>
+__attribute__((always_inline))
+inline void compareLanes(const typename T::c_type* data, const typename T::c_type* operands, uint64_t operandCount,
+                         typename vector_lanes<typename T::c_type, WIDTH>::mask_type& mask)
+{
+    typename vector_lanes<typename T::c_type, WIDTH>::type values;
+    memcpy(&values, data, sizeof(values));
+
+    switch(OP)
+    {
+    case CompareOp::EQ: mask = values == operands[0]; break;
+    case CompareOp::NE: mask = values != operands[0]; break;
+    case CompareOp::LT: mask = values < operands[0]; break;
+    case CompareOp::LE: mask = values <= operands[0]; break;
+    case CompareOp::GT: mask = values > operands[0]; break;
+    case CompareOp::GE: mask = values >= operands[0]; break;
+    case CompareOp::BETWEEN: mask = (values >= operands[0]) & (values <= operands[1]); break;
+    default:
+        mask = typename vector_lanes<typename T::c_type, WIDTH>::mask_type{};
+        for(uint64_t j = 0; j < operandCount; ++j)
+        {
+            mask |= values == operands[j];
+        }
+        break;
+    }
+}
+
+template<typename T, int OP>
+inline bool compareValue(typename T::c_type value, const typename T::c_type* operands, uint64_t operandCount)
+{
+    switch(OP)
+    {
+    case CompareOp::EQ: return value == operands[0];
+    case CompareOp::NE: return value != operands[0];
+    case CompareOp::LT: return value < operands[0];
+    case CompareOp::LE: return value <= operands[0];
+    case CompareOp::GT: return value > operands[0];
+    case CompareOp::GE: return value >= operands[0];
+    case CompareOp::BETWEEN: return value >= operands[0] && value <= operands[1];
+    default:
+        for(uint64_t j = 0; j < operandCount; ++j)
+        {
+            if (value == operands[j])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+template<typename T, int OP>
+void compareScalar(const typename T::c_type* data, uint64_t size, const typename T::c_type* operands, uint64_t operandCount, uint64_t* words)
+{
+    for(uint64_t i = 0; i < size; i += 64)
+    {
+        uint64_t rows = size - i < 64 ? size - i : 64;
+        uint64_t word = 0;
+        for(uint64_t j = 0; j < rows; ++j)
+        {
+            word |= static_cast<uint64_t>(compareValue<T, OP>(data[i + j], operands, operandCount)) << j;
+        }
+        words[i / 64] = word;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<typename T, int OP>
+__attribute__((target("avx2")))
+void compareAvx2(const typename T::c_type* data, uint64_t size, const typename T::c_type* operands, uint64_t operandCount, uint64_t* words)
+{
+    typedef typename T::c_type c_type;
+    constexpr uint64_t lanes = 32 / sizeof(c_type);
+
+    uint64_t i = 0;
+    for(; i + 64 <= size; i += 64)
+    {
+        uint64_t word = 0;
+        for(uint64_t k = 0; k < 64; k += lanes)
+        {
+            typename vector_lanes<c_type, 32>::mask_type mask;
+            compareLanes<T, OP, 32>(data + i + k, operands, operandCount, mask);
+            __m256i bits;
+            memcpy(&bits, &mask, sizeof(bits));
+
+            uint64_t lane_bits = 0;
+            if constexpr (sizeof(c_type) == 1)
+            {
+                lane_bits = static_cast<uint32_t>(_mm256_movemask_epi8(bits));
+            }
+            else if constexpr (sizeof(c_type) == 2)
+            {
+                __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1));
+                lane_bits = static_cast<uint16_t>(_mm_movemask_epi8(packed));
+            }
+            else if constexpr (sizeof(c_type) == 4)
+            {
+                lane_bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(bits)));
+            }
+            else
+            {
+                lane_bits = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(bits)));
+            }
+            word |= lane_bits << k;
+        }
+        words[i / 64] = word;
+    }
+
+    if (i < size)
+    {
+        compareScalar<T, OP>(data + i, size - i, operands, operandCount, words + i / 64);
+    }
+}
+
+template<typename T, int OP>
+__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl")))
+void compareAvx512(const typename T::c_type* data, uint64_t size, const typename T::c_type* operands, uint64_t operandCount, uint64_t* words)
+{
+    typedef typename T::c_type c_type;
+    constexpr uint64_t lanes = 64 / sizeof(c_type);
+
+    uint64_t i = 0;
+    for(; i + 64 <= size; i += 64)
+    {
+        uint64_t word = 0;
+        for(uint64_t k = 0; k < 64; k += lanes)
+        {
+            typename vector_lanes<c_type, 64>::mask_type mask;
+            compareLanes<T, OP, 64>(data + i + k, operands, operandCount, mask);
+            __m512i bits;
+            memcpy(&bits, &mask, sizeof(bits));
+
+            uint64_t lane_bits = 0;
+            if constexpr (sizeof(c_type) == 1)
+            {
+                lane_bits = static_cast<uint64_t>(_mm512_movepi8_mask(bits));
+            }
+            else if constexpr (sizeof(c_type) == 2)
+            {
+                lane_bits = static_cast<uint64_t>(_mm512_movepi16_mask(bits));
+            }
+            else if constexpr (sizeof(c_type) == 4)
+            {
+                lane_bits = static_cast<uint64_t>(_mm512_movepi32_mask(bits));
+            }
+            else
+            {
+                lane_bits = static_cast<uint64_t>(_mm512_movepi64_mask(bits));
+            }
+            word |= lane_bits << k;
+        }
+        words[i / 64] = word;
+    }
+
+    if (i < size)
+    {
+        compareScalar<T, OP>(data + i, size - i, operands, operandCount, words + i / 64);
+    }
+}
+#endif
+
+template<typename T, int OP>
+inline void compare(const typename T::c_type* data, uint64_t size, const typename T::c_type* operands, uint64_t operandCount, uint64_t* words, Isa::type isa)
+{
+    switch(isa)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::AVX512:
+        compareAvx512<T, OP>(data, size, operands, operandCount, words);
+        break;
+    case Isa::AVX2:
+        compareAvx2<T, OP>(data, size, operands, operandCount, words);
+        break;
+#endif
+    default:
+        compareScalar<T, OP>(data, size, operands, operandCount, words);
+        break;
+    }
+}
+
+// Comparisons take one operand, BETWEEN two and IN any number.
+inline void checkOperands(CompareOp::type op, uint64_t count)
+{
+    if (op > CompareOp::IN)
+    {
+        throw std::invalid_argument("unknown compare op " + std::to_string(op));
+    }
+    if (op == CompareOp::BETWEEN && count != 2)
+    {
+        throw std::invalid_argument("BETWEEN takes 2 operands, not " + std::to_string(count));
+    }
+    if (op < CompareOp::BETWEEN && count != 1)
+    {
+        throw std::invalid_argument("comparisons take 1 operand, not " + std::to_string(count));
+    }
+}
+
+template<typename T>
+inline void filter(const typename T::c_type* data, uint64_t size, CompareOp::type op, const std::vector<typename T::c_type>& operands, uint64_t* words, Isa::type isa = Isa::detect())
+{
+    checkOperands(op, operands.size());
+    const typename T::c_type* values = operands.data();
+    uint64_t count = operands.size();
+
+    switch(op)
+    {
+    case CompareOp::EQ: compare<T, CompareOp::EQ>(data, size, values, count, words, isa); break;
+    case CompareOp::NE: compare<T, CompareOp::NE>(data, size, values, count, words, isa); break;
+    case CompareOp::LT: compare<T, CompareOp::LT>(data, size, values, count, words, isa); break;
+    case CompareOp::LE: compare<T, CompareOp::LE>(data, size, values, count, words, isa); break;
+    case CompareOp::GT: compare<T, CompareOp::GT>(data, size, values, count, words, isa); break;
+    case CompareOp::GE: compare<T, CompareOp::GE>(data, size, values, count, words, isa); break;
+    case CompareOp::BETWEEN: compare<T, CompareOp::BETWEEN>(data, size, values, count, words, isa); break;
+    default: compare<T, CompareOp::IN>(data, size, values, count, words, isa); break;
+    }
+}
+
+template<typename T>
+inline void filter(const typename T::c_type* data, uint64_t size, CompareOp::type op, const std::vector<typename T::c_type>& operands, Bitmap& selection, Isa::type isa = Isa::detect())
+{
+    selection.resize(size);
+    filter<T>(data, size, op, operands, selection.words(), isa);
+}
+
+// False when no row of the group can satisfy the comparison, so the group can be skipped.
+template<typename T>
+inline bool mayMatch(const Zone<T>& zone, CompareOp::type op, const std::vector<typename T::c_type>& operands)
+{
+    if (zone.rows == 0 || operands.empty())
+    {
+        return false;
+    }
+
+    switch(op)
+    {
+    case CompareOp::EQ: return operands[0] >= zone.min && operands[0] <= zone.max;
+    case CompareOp::NE: return std::is_floating_point<typename T::c_type>::value || zone.min != operands[0] || zone.max != operands[0];
+    case CompareOp::LT: return zone.min < operands[0];
+    case CompareOp::LE: return zone.min <= operands[0];
+    case CompareOp::GT: return zone.max > operands[0];
+    case CompareOp::GE: return zone.max >= operands[0];
+    case CompareOp::BETWEEN: return operands.size() > 1 && zone.max >= operands[0] && zone.min <= operands[1];
+    default:
+        for(typename T::c_type operand : operands)
+        {
+            if (operand >= zone.min && operand <= zone.max)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// Sets bit g of groups for every row group that may hold a match.
+template<typename T>
+inline void candidateGroups(const ZoneMap<T>& zones, CompareOp::type op, const std::vector<typename T::c_type>& operands, Bitmap& groups)
+{
+    groups.resize(0);
+    groups.resize(zones.groupCount());
+    for(uint64_t g = 0; g < zones.groupCount(); ++g)
+    {
+        groups.set(g, mayMatch<T>(zones.zone(g), op, operands));
+    }
+}
+
+class Predicate
+{
+public:
+    virtual ~Predicate() {}
+    virtual void evaluate(Bitmap& selection) = 0;
+};
+
+template<typename T, typename C = TypedColumn<PlainStore, T>>
+class ColumnPredicate: public Predicate
+{
+private:
+    typedef typename T::c_type c_type;
+
+    C& _column;
+    CompareOp::type _op;
+    std::vector<c_type> _operands;
+    Bitmap _groups;
+    uint64_t _skipped = 0;
+public:
+    ColumnPredicate(C& column, CompareOp::type op, std::vector<c_type> operands)
+        :_column(column), _op(op), _operands(std::move(operands))
+    {
+        checkOperands(_op, _operands.size());
+    }
+    // Row groups ruled out by the zone map are left unselected without reading their values.
+    void evaluate(Bitmap& selection) override
+    {
+        selection.resize(0);
+        selection.resize(_column.size());
+
+        ZoneMap<T>& zones = _column.zones();
+        uint64_t groupSize = zones.groupSize();
+        candidateGroups<T>(zones, _op, _operands, _groups);
+        _skipped = _groups.size() - _groups.count();
+
+        for(uint64_t i = 0; i < _column.chunkCount(); ++i)
+        {
+            ColumnChunk<T> chunk = _column.chunk(i);
+            uint64_t end = chunk.offset + chunk.size;
+            for(uint64_t start = chunk.offset; start < end;)
+            {
+                uint64_t group = start / groupSize;
+                uint64_t stop = (group + 1) * groupSize < end ? (group + 1) * groupSize : end;
+                if (group >= _groups.size() || _groups.get(group))
+                {
+                    filter<T>(chunk.data + (start - chunk.offset), stop - start, _op, _operands, selection.words() + start / 64);
+                }
+                start = stop;
+            }
+        }
+        clearNulls(_column, selection);
+    }
+    // Row groups skipped by the last evaluate().
+    inline uint64_t skipped() const
+    {
+        return _skipped;
+    }
+private:
+    static void clearNulls(TypedColumn<PlainStore, T>&, Bitmap&) {}
+    static void clearNulls(NullableTypedColumn<PlainStore, T>& column, Bitmap& selection)
+    {
+        column.validity().intersect(selection);
+    }
+};
+
+// Decodes one block at a time into a buffer and filters it there; blocks whose row groups the zone
+// map rules out are not decoded.
+template<typename T, typename C = TypedColumn<BitPackedStore, T>>
+class PackedPredicate: public Predicate
+{
+private:
+    typedef typename T::c_type c_type;
+
+    C& _column;
+    CompareOp::type _op;
+    std::vector<c_type> _operands;
+    Bitmap _groups;
+public:
+    PackedPredicate(C& column, CompareOp::type op, std::vector<c_type> operands)
+        :_column(column), _op(op), _operands(std::move(operands))
+    {
+        checkOperands(_op, _operands.size());
+    }
+    void evaluate(Bitmap& selection) override
+    {
+        TypeStore<BitPackedStore>& store = _column.store();
+        selection.resize(0);
+        selection.resize(store.size());
+
+        ZoneMap<T>& zones = _column.zones();
+        candidateGroups<T>(zones, _op, _operands, _groups);
+
+        c_type values[BitPacking::block_size];
+        for(uint64_t block = 0; block < store.blockCount(); ++block)
+        {
+            uint64_t first = block * BitPacking::block_size;
+            uint64_t last = first + BitPacking::block_size - 1;
+            if (!candidate(first / zones.groupSize()) && !candidate(last / zones.groupSize()))
+            {
+                continue;
+            }
+            uint64_t rows = store.decode(block, values);
+            filter<T>(values, rows, _op, _operands, selection.words() + first / 64);
+        }
+        clearNulls(_column, selection);
+    }
+private:
+    inline bool candidate(uint64_t group)
+    {
+        return group >= _groups.size() || _groups.get(group);
+    }
+    static void clearNulls(TypedColumn<BitPackedStore, T>&, Bitmap&) {}
+    static void clearNulls(NullableTypedColumn<BitPackedStore, T>& column, Bitmap& selection)
+    {
+        column.validity().intersect(selection);
+    }
+};
+
+// On a sorted store, range comparisons become one row range found by binary search over the
+// checkpoints; anything else decodes a checkpoint block at a time and filters it.
+template<typename C = TypedColumn<DeltaStore, Int64Type>>
+class DeltaPredicate: public Predicate
+{
+private:
+    C& _column;
+    CompareOp::type _op;
+    std::vector<int64_t> _operands;
+public:
+    DeltaPredicate(C& column, CompareOp::type op, std::vector<int64_t> operands)
+        :_column(column), _op(op), _operands(std::move(operands))
+    {
+        checkOperands(_op, _operands.size());
+    }
+    void evaluate(Bitmap& selection) override
+    {
+        TypeStore<DeltaStore>& store = _column.store();
+        selection.resize(0);
+        selection.resize(store.size());
+
+        if (store.sorted() && _op != CompareOp::NE && _op != CompareOp::IN)
+        {
+            uint64_t begin = 0;
+            uint64_t end = store.size();
+            switch(_op)
+            {
+            case CompareOp::EQ: begin = store.lowerBound(_operands[0]); end = store.upperBound(_operands[0]); break;
+            case CompareOp::LT: end = store.lowerBound(_operands[0]); break;
+            case CompareOp::LE: end = store.upperBound(_operands[0]); break;
+            case CompareOp::GT: begin = store.upperBound(_operands[0]); break;
+            case CompareOp::GE: begin = store.lowerBound(_operands[0]); break;
+            default:
+                if (_operands[0] > _operands[1])
+                {
+                    end = 0;
+                    break;
+                }
+                begin = store.lowerBound(_operands[0]);
+                end = store.upperBound(_operands[1]);
+                break;
+            }
+            if (begin < end)
+            {
+                selection.setRange(begin, end);
+            }
+        }
+        else
+        {
+            int64_t values[TypeStore<DeltaStore>::checkpoint_interval];
+            for(uint64_t block = 0; block < store.blockCount(); ++block)
+            {
+                uint64_t rows = store.decode(block, values);
+                filter<Int64Type>(values, rows, _op, _operands, selection.words() + block * TypeStore<DeltaStore>::checkpoint_interval / 64);
+            }
+        }
+        clearNulls(_column, selection);
+    }
+private:
+    static void clearNulls(TypedColumn<DeltaStore, Int64Type>&, Bitmap&) {}
+    static void clearNulls(NullableTypedColumn<DeltaStore, Int64Type>& column, Bitmap& selection)
+    {
+        column.validity().intersect(selection);
+    }
+};
+
+// Compares the value of each run once and selects whole runs.
+template<typename T, typename C = TypedColumn<RleStore, T>>
+class RunPredicate: public Predicate
+{
+private:
+    typedef typename T::c_type c_type;
+
+    C& _column;
+    CompareOp::type _op;
+    std::vector<c_type> _operands;
+public:
+    RunPredicate(C& column, CompareOp::type op, std::vector<c_type> operands)
+        :_column(column), _op(op), _operands(std::move(operands))
+    {
+        checkOperands(_op, _operands.size());
+    }
+    void evaluate(Bitmap& selection) override
+    {
+        TypeStore<RleStore>& runs = _column.store();
+        selection.resize(0);
+        selection.resize(runs.size());
+        for(uint64_t i = 0; i < runs.runCount(); ++i)
+        {
+            c_type value;
+            memcpy(&value, runs.value(i)._data, sizeof(value));
+            if (matches(value))
+            {
+                selection.setRange(runs.runStart(i), runs.runEnd(i));
+            }
+        }
+        clearNulls(_column, selection);
+    }
+private:
+    inline bool matches(c_type value)
+    {
+        const c_type* operands = _operands.data();
+        uint64_t count = _operands.size();
+
+        switch(_op)
+        {
+        case CompareOp::EQ: return compareValue<T, CompareOp::EQ>(value, operands, count);
+        case CompareOp::NE: return compareValue<T, CompareOp::NE>(value, operands, count);
+        case CompareOp::LT: return compareValue<T, CompareOp::LT>(value, operands, count);
+        case CompareOp::LE: return compareValue<T, CompareOp::LE>(value, operands, count);
+        case CompareOp::GT: return compareValue<T, CompareOp::GT>(value, operands, count);
+        case CompareOp::GE: return compareValue<T, CompareOp::GE>(value, operands, count);
+        case CompareOp::BETWEEN: return compareValue<T, CompareOp::BETWEEN>(value, operands, count);
+        default: return compareValue<T, CompareOp::IN>(value, operands, count);
+        }
+    }
+    static void clearNulls(TypedColumn<RleStore, T>&, Bitmap&) {}
+    static void clearNulls(NullableTypedColumn<RleStore, T>& column, Bitmap& selection)
+    {
+        column.validity().intersect(selection);
+    }
+};
+
+template<typename C = TypedColumn<DictStore, StringType>>
+class DictionaryPredicate: public Predicate
+{
+private:
+    C& _column;
+    CompareOp::type _op;
+    std::vector<uint32_t> _codes;
+public:
+    // Supports EQ and IN, and NE as NOT IN over all its values; the values are resolved to codes once
+    // and the scan runs on the codes.
+    DictionaryPredicate(C& column, CompareOp::type op, std::vector<std::string> values)
+        :_column(column), _op(op)
+    {
+        if (op != CompareOp::EQ && op != CompareOp::NE && op != CompareOp::IN)
+        {
+            throw std::invalid_argument("dictionary predicates support EQ, NE and IN only");
+        }
+        for(std::string& value : values)
+        {
+            ViewByteBuffer view(value.size(), value.data());
+            int64_t code = _column.dictionary().find(view);
+            if (code >= 0)
+            {
+                _codes.push_back(static_cast<uint32_t>(code));
+            }
+        }
+    }
+    void evaluate(Bitmap& selection) override
+    {
+        TypeStore<DictStore>& dictionary = _column.dictionary();
+        uint64_t size = dictionary.size();
+
+        if (_codes.empty())
+        {
+            selection.resize(0);
+            selection.resize(size, _op == CompareOp::NE);
+        }
+        else
+        {
+            CompareOp::type op = _codes.size() == 1 ? CompareOp::EQ : CompareOp::IN;
+            switch(dictionary.codeWidth())
+            {
+            case 1: filterCodes<UInt8Type>(dictionary, op, selection); break;
+            case 2: filterCodes<UInt16Type>(dictionary, op, selection); break;
+            default: filterCodes<UInt32Type>(dictionary, op, selection); break;
+            }
+            if (_op == CompareOp::NE)
+            {
+                selection.invert();
+            }
+        }
+        clearNulls(_column, selection);
+    }
+private:
+    template<typename T>
+    inline void filterCodes(TypeStore<DictStore>& dictionary, CompareOp::type op, Bitmap& selection)
+    {
+        std::vector<typename T::c_type> operands(_codes.begin(), _codes.end());
+        filter<T>(reinterpret_cast<const typename T::c_type*>(dictionary.codes()), dictionary.size(), op, operands, selection);
+    }
+    static void clearNulls(TypedColumn<DictStore, StringType>&, Bitmap&) {}
+    static void clearNulls(NullableTypedColumn<DictStore, StringType>& column, Bitmap& selection)
+    {
+        column.validity().intersect(selection);
+    }
+};
+
+class AndPredicate: public Predicate
+{
+private:
+    std::unique_ptr<Predicate> _left;
+    std::unique_ptr<Predicate> _right;
+public:
+    AndPredicate(std::unique_ptr<Predicate> left, std::unique_ptr<Predicate> right)
+        :_left(std::move(left)), _right(std::move(right)) {}
+    void evaluate(Bitmap& selection) override
+    {
+        Bitmap right;
+        _left->evaluate(selection);
+        _right->evaluate(right);
+        selection &= right;
+    }
+};
+
+class OrPredicate: public Predicate
+{
+private:
+    std::unique_ptr<Predicate> _left;
+    std::unique_ptr<Predicate> _right;
+public:
+    OrPredicate(std::unique_ptr<Predicate> left, std::unique_ptr<Predicate> right)
+        :_left(std::move(left)), _right(std::move(right)) {}
+    void evaluate(Bitmap& selection) override
+    {
+        Bitmap right;
+        _left->evaluate(selection);
+        _right->evaluate(right);
+        selection |= right;
+    }
+};
+
+template<typename T>
+inline void gather(const typename T::c_type* data, const Bitmap& selection, std::vector<typename T::c_type>& out)
+{
+    out.clear();
+    out.reserve(selection.count());
+    const uint64_t* words = selection.words();
+    for(uint64_t i = 0; i < selection.wordCount(); ++i)
+    {
+        uint64_t word = words[i];
+        while(word != 0)
+        {
+            out.push_back(data[i * 64 + static_cast<uint64_t>(__builtin_ctzll(word))]);
+            word &= word - 1;
+        }
+    }
+}
+
+// Appends the selected rows of column to out, nulls as nulls.
+inline void gather(Column& column, const Bitmap& selection, Column& out)
+{
+    std::vector<uint64_t> positions;
+    selection.positions(positions);
+    gather(column, positions.data(), positions.size(), out);
+}
+
+#endif // FILTER_H
@@ -0,0 +1,569 @@
+#ifndef GROUPBY_H
+#define GROUPBY_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <memory.h>
+
+#include "column.h"
+#include "aggregate.h"
+#include "hash.h"
+#include "parallel.h"
+
+// One key column, read a batch of rows at a time as 64-bit keys.
+class GroupKeys
+{
+public:
+    virtual ~GroupKeys() {}
+    virtual uint64_t size() = 0;
+    // Number of keys when they are dense codes in [0, cardinality), else 0.
+    virtual uint64_t cardinality()
+    {
+        return 0;
+    }
+    virtual void read(uint64_t begin, uint64_t count, uint64_t* out) = 0;
+};
+
+// Dictionary codes as keys; they resolve back to values through the dictionary.
+class CodeKeys: public GroupKeys
+{
+private:
+    TypeStore<DictStore>& _dictionary;
+public:
+    explicit CodeKeys(TypeStore<DictStore>& dictionary):_dictionary(dictionary) {}
+    uint64_t size() override
+    {
+        return _dictionary.size();
+    }
+    uint64_t cardinality() override
+    {
+        return _dictionary.cardinality();
+    }
+    void read(uint64_t begin, uint64_t count, uint64_t* out) override
+    {
+        const char* codes = _dictionary.codes() + begin * _dictionary.codeWidth();
+        switch(_dictionary.codeWidth())
+        {
+        case 1: widen(reinterpret_cast<const uint8_t*>(codes), count, out); break;
+        case 2: widen(reinterpret_cast<const uint16_t*>(codes), count, out); break;
+        default: widen(reinterpret_cast<const uint32_t*>(codes), count, out); break;
+        }
+    }
+private:
+    template<typename K>
+    static inline void widen(const K* codes, uint64_t count, uint64_t* out)
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            out[i] = codes[i];
+        }
+    }
+};
+
+// Values of a plain fixed width column as keys, by their bit pattern.
+template<typename U, typename C = TypedColumn<PlainStore, U>>
+class ValueKeys: public GroupKeys
+{
+private:
+    typedef typename U::c_type c_type;
+
+    C& _column;
+public:
+    explicit ValueKeys(C& column):_column(column) {}
+    uint64_t size() override
+    {
+        return _column.size();
+    }
+    void read(uint64_t begin, uint64_t count, uint64_t* out) override
+    {
+        c_type buffer[1024];
+        for(uint64_t done = 0; done < count;)
+        {
+            uint64_t rows = count - done < 1024 ? count - done : 1024;
+            const c_type* values = plainRows<U>(_column, begin + done, rows, buffer);
+            for(uint64_t i = 0; i < rows; ++i)
+            {
+                uint64_t key = 0;
+                memcpy(&key, &values[i], sizeof(c_type));
+                out[done + i] = key;
+            }
+            done += rows;
+        }
+    }
+};
+
+// One column of values to aggregate, read a batch of rows at a time.
+template<typename T>
+class GroupValues
+{
+public:
+    typedef typename T::c_type c_type;
+
+    virtual ~GroupValues() {}
+    virtual uint64_t size() = 0;
+    virtual const c_type* read(uint64_t begin, uint64_t count, c_type* buffer) = 0;
+    // Validity bits of every row, or nullptr when there are no nulls.
+    virtual const uint64_t* validity() = 0;
+};
+
+template<typename T, typename C = TypedColumn<PlainStore, T>>
+class PlainValues: public GroupValues<T>
+{
+private:
+    typedef typename T::c_type c_type;
+
+    C& _column;
+public:
+    explicit PlainValues(C& column):_column(column) {}
+    uint64_t size() override
+    {
+        return _column.size();
+    }
+    const c_type* read(uint64_t begin, uint64_t count, c_type* buffer) override
+    {
+        return plainRows<T>(_column, begin, count, buffer);
+    }
+    const uint64_t* validity() override
+    {
+        return validity(_column);
+    }
+private:
+    static const uint64_t* validity(TypedColumn<PlainStore, T>&)
+    {
+        return nullptr;
+    }
+    static const uint64_t* validity(NullableTypedColumn<PlainStore, T>& column)
+    {
+        return column.validity().words();
+    }
+};
+
+template<typename T>
+inline void accumulate(Aggregate<T>& group, typename T::c_type value)
+{
+    group.count++;
+    group.sum = static_cast<typename Aggregate<T>::sum_type>(group.sum + value);
+    group.min = value < group.min ? value : group.min;
+    group.max = value > group.max ? value : group.max;
+}
+
+// Open addressing with linear probing over composite keys of width 64-bit words. Slots hold a hash
+// tag and the index of an entry; entries (keys, row count and aggregates) are appended in insertion
+// order and never move, so growing the table only rehashes the slots.
+template<typename T>
+class GroupTable
+{
+private:
+    struct Slot
+    {
+        uint64_t tag;
+        uint64_t entry;
+    };
+
+    uint64_t _width;
+    uint64_t _values;
+    uint64_t _mask;
+    std::vector<Slot> _slots;
+    std::vector<uint64_t> _entries;
+    std::vector<Aggregate<T>> _aggregates;
+public:
+    GroupTable(uint64_t width, uint64_t values, uint64_t capacity = 256)
+        :_width(width), _values(values)
+    {
+        resize(capacity);
+    }
+    // Entry of key, added with no rows when absent.
+    inline uint64_t find(const uint64_t* key, uint64_t hash)
+    {
+        uint64_t tag = hash | 1;
+        for(uint64_t slot = (hash >> 1) & _mask;; slot = (slot + 1) & _mask)
+        {
+            Slot& current = _slots[slot];
+            if (current.tag == tag && equal(&_entries[current.entry * (_width + 1)], key))
+            {
+                return current.entry;
+            }
+            if (current.tag == 0)
+            {
+                uint64_t entry = size();
+                current.tag = tag;
+                current.entry = entry;
+                _entries.insert(_entries.end(), key, key + _width);
+                _entries.push_back(0);
+                _aggregates.resize(_aggregates.size() + _values);
+                if ((entry + 1) * 2 > _slots.size())
+                {
+                    resize(_slots.size() * 2);
+                }
+                return entry;
+            }
+        }
+    }
+    inline void addRows(uint64_t entry, uint64_t rows)
+    {
+        _entries[entry * (_width + 1) + _width] += rows;
+    }
+    inline Aggregate<T>& aggregate(uint64_t entry, uint64_t value)
+    {
+        return _aggregates[entry * _values + value];
+    }
+    inline void merge(GroupTable<T>& other)
+    {
+        for(const Slot& slot : other._slots)
+        {
+            if (slot.tag == 0)
+            {
+                continue;
+            }
+            uint64_t target = find(other.key(slot.entry), slot.tag);
+            addRows(target, other.rows(slot.entry));
+            for(uint64_t v = 0; v < _values; ++v)
+            {
+                aggregate(target, v).merge(other.aggregate(slot.entry, v));
+            }
+        }
+    }
+    inline uint64_t size() const
+    {
+        return _entries.size() / (_width + 1);
+    }
+    inline const uint64_t* key(uint64_t entry) const
+    {
+        return &_entries[entry * (_width + 1)];
+    }
+    inline uint64_t rows(uint64_t entry) const
+    {
+        return _entries[entry * (_width + 1) + _width];
+    }
+private:
+    inline bool equal(const uint64_t* left, const uint64_t* right) const
+    {
+        for(uint64_t k = 0; k < _width; ++k)
+        {
+            if (left[k] != right[k])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    inline void resize(uint64_t capacity)
+    {
+        std::vector<Slot> slots(capacity, Slot{0, 0});
+        uint64_t mask = capacity - 1;
+        for(const Slot& slot : _slots)
+        {
+            if (slot.tag == 0)
+            {
+                continue;
+            }
+            uint64_t target = (slot.tag >> 1) & mask;
+            while(slots[target].tag != 0)
+            {
+                target = (target + 1) & mask;
+            }
+            slots[target] = slot;
+        }
+        _slots.swap(slots);
+        _mask = mask;
+    }
+};
+
+// One group per row: its keys (dictionary codes for dictionary key columns), its row count, i.e.
+// COUNT(*), and per value column an Aggregate with COUNT, SUM, MIN, MAX and mean() for AVG.
+template<typename T>
+struct GroupByResult
+{
+    uint64_t width = 0;
+    uint64_t values = 0;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> rows;
+    std::vector<Aggregate<T>> aggregates;
+
+    inline uint64_t groupCount() const
+    {
+        return rows.size();
+    }
+    inline uint64_t key(uint64_t group, uint64_t column) const
+    {
+        return keys[group * width + column];
+    }
+    inline const Aggregate<T>& aggregate(uint64_t group, uint64_t value) const
+    {
+        return aggregates[group * values + value];
+    }
+};
+
+// GROUP BY one or more key columns over value columns of type T. Workers take morsels of rows and
+// pre-aggregate into tables of their own, split by the top hash bits into partitions; partitions
+// are then merged across workers in parallel, one partition per task. A single dictionary key
+// skips hashing: every worker aggregates into an array indexed by code and the code range is split
+// between workers for the merge. Groups come out in code order on that path, otherwise unordered.
+template<typename T>
+class HashGroupBy
+{
+public:
+    static constexpr uint64_t batch_size = 1024;
+    static constexpr uint64_t morsel_size = 64 * 1024;
+    static constexpr uint64_t partition_bits = 6;
+    static constexpr uint64_t partitions = uint64_t(1) << partition_bits;
+private:
+    typedef typename T::c_type c_type;
+
+    uint32_t _workers;
+    std::vector<std::unique_ptr<GroupKeys>> _keys;
+    std::vector<std::unique_ptr<GroupValues<T>>> _values;
+public:
+    explicit HashGroupBy(uint32_t workers = std::thread::hardware_concurrency())
+        :_workers(workers > 0 ? workers : 1) {}
+    inline void key(TypeStore<DictStore>& dictionary)
+    {
+        _keys.emplace_back(new CodeKeys(dictionary));
+    }
+    inline void key(TypedColumn<DictStore, StringType>& column)
+    {
+        key(column.dictionary());
+    }
+    template<typename U>
+    inline void key(TypedColumn<PlainStore, U>& column)
+    {
+        _keys.emplace_back(new ValueKeys<U>(column));
+    }
+    inline void key(std::unique_ptr<GroupKeys> keys)
+    {
+        _keys.push_back(std::move(keys));
+    }
+    inline void value(TypedColumn<PlainStore, T>& column)
+    {
+        _values.emplace_back(new PlainValues<T>(column));
+    }
+    inline void value(NullableTypedColumn<PlainStore, T>& column)
+    {
+        _values.emplace_back(new PlainValues<T, NullableTypedColumn<PlainStore, T>>(column));
+    }
+    GroupByResult<T> run()
+    {
+        if (_keys.empty())
+        {
+            throw std::logic_error("group by needs at least one key column");
+        }
+        uint64_t rows = _keys[0]->size();
+        for(uint64_t i = 1; i < _keys.size(); ++i)
+        {
+            if (_keys[i]->size() != rows)
+            {
+                throw std::logic_error("key column " + std::to_string(i) + " holds " + std::to_string(_keys[i]->size()) + " rows, not " + std::to_string(rows));
+            }
+        }
+        for(uint64_t i = 0; i < _values.size(); ++i)
+        {
+            if (_values[i]->size() != rows)
+            {
+                throw std::logic_error("value column " + std::to_string(i) + " holds " + std::to_string(_values[i]->size()) + " rows, not " + std::to_string(rows));
+            }
+        }
+
+        if (_keys.size() == 1 && _keys[0]->cardinality() > 0)
+        {
+            return dense(rows, _keys[0]->cardinality());
+        }
+        return hashed(rows);
+    }
+private:
+    inline uint32_t workersFor(uint64_t tasks)
+    {
+        return ::workersFor(tasks, _workers);
+    }
+    // Calls f(begin, count, values, validity) per batch of the morsels taken from next.
+    template<typename F>
+    inline void scan(uint64_t rows, std::atomic<uint64_t>& next, F f)
+    {
+        std::vector<std::vector<c_type>> buffers(_values.size(), std::vector<c_type>(batch_size));
+        std::vector<const c_type*> values(_values.size());
+        std::vector<const uint64_t*> validity(_values.size());
+        for(uint64_t v = 0; v < _values.size(); ++v)
+        {
+            validity[v] = _values[v]->validity();
+        }
+
+        for(uint64_t morsel = next.fetch_add(morsel_size); morsel < rows; morsel = next.fetch_add(morsel_size))
+        {
+            uint64_t end = morsel + morsel_size < rows ? morsel + morsel_size : rows;
+            for(uint64_t begin = morsel; begin < end; begin += batch_size)
+            {
+                uint64_t count = end - begin < batch_size ? end - begin : batch_size;
+                for(uint64_t v = 0; v < _values.size(); ++v)
+                {
+                    values[v] = _values[v]->read(begin, count, buffers[v].data());
+                }
+                f(begin, count, values, validity);
+            }
+        }
+    }
+    static inline bool valid(const uint64_t* validity, uint64_t row)
+    {
+        return validity == nullptr || ((validity[row / 64] >> (row % 64)) & 1) != 0;
+    }
+    GroupByResult<T> dense(uint64_t rows, uint64_t cardinality)
+    {
+        uint64_t valueCount = _values.size();
+        uint32_t workers = workersFor((rows + morsel_size - 1) / morsel_size);
+        std::vector<std::vector<uint64_t>> counts(workers);
+        std::vector<std::vector<Aggregate<T>>> locals(workers);
+        std::atomic<uint64_t> next{0};
+
+        parallel(workers, [&](uint32_t w) {
+            std::vector<uint64_t>& count = counts[w];
+            std::vector<Aggregate<T>>& local = locals[w];
+            count.resize(cardinality, 0);
+            local.resize(cardinality * valueCount);
+            std::vector<uint64_t> codes(batch_size);
+            scan(rows, next, [&](uint64_t begin, uint64_t size, std::vector<const c_type*>& values, std::vector<const uint64_t*>& validity) {
+                _keys[0]->read(begin, size, codes.data());
+                for(uint64_t i = 0; i < size; ++i)
+                {
+                    count[codes[i]]++;
+                }
+                for(uint64_t v = 0; v < valueCount; ++v)
+                {
+                    Aggregate<T>* groups = local.data() + v;
+                    const c_type* data = values[v];
+                    if (validity[v] == nullptr)
+                    {
+                        for(uint64_t i = 0; i < size; ++i)
+                        {
+                            accumulate<T>(groups[codes[i] * valueCount], data[i]);
+                        }
+                        continue;
+                    }
+                    for(uint64_t i = 0; i < size; ++i)
+                    {
+                        if (valid(validity[v], begin + i))
+                        {
+                            accumulate<T>(groups[codes[i] * valueCount], data[i]);
+                        }
+                    }
+                }
+            });
+        });
+
+        std::vector<uint64_t> total(cardinality, 0);
+        std::vector<Aggregate<T>> merged(cardinality * valueCount);
+        uint32_t mergers = workersFor(cardinality / 4096 + 1);
+        parallel(mergers, [&](uint32_t m) {
+            uint64_t first = cardinality * m / mergers;
+            uint64_t last = cardinality * (m + 1) / mergers;
+            for(uint32_t w = 0; w < workers; ++w)
+            {
+                for(uint64_t code = first; code < last; ++code)
+                {
+                    total[code] += counts[w][code];
+                    for(uint64_t v = 0; v < valueCount; ++v)
+                    {
+                        merged[code * valueCount + v].merge(locals[w][code * valueCount + v]);
+                    }
+                }
+            }
+        });
+
+        GroupByResult<T> result;
+        result.width = 1;
+        result.values = valueCount;
+        for(uint64_t code = 0; code < cardinality; ++code)
+        {
+            if (total[code] == 0)
+            {
+                continue;
+            }
+            result.keys.push_back(code);
+            result.rows.push_back(total[code]);
+            result.aggregates.insert(result.aggregates.end(), merged.begin() + code * valueCount, merged.begin() + (code + 1) * valueCount);
+        }
+        return result;
+    }
+    GroupByResult<T> hashed(uint64_t rows)
+    {
+        uint64_t width = _keys.size();
+        uint64_t valueCount = _values.size();
+        uint32_t workers = workersFor((rows + morsel_size - 1) / morsel_size);
+        std::vector<std::vector<GroupTable<T>>> tables(workers);
+        std::atomic<uint64_t> next{0};
+
+        parallel(workers, [&](uint32_t w) {
+            std::vector<GroupTable<T>>& local = tables[w];
+            local.reserve(partitions);
+            for(uint64_t p = 0; p < partitions; ++p)
+            {
+                local.emplace_back(width, valueCount);
+            }
+            std::vector<uint64_t> keys(width * batch_size);
+            std::vector<uint64_t> tuple(width);
+
+            scan(rows, next, [&](uint64_t begin, uint64_t size, std::vector<const c_type*>& values, std::vector<const uint64_t*>& validity) {
+                for(uint64_t k = 0; k < width; ++k)
+                {
+                    _keys[k]->read(begin, size, &keys[k * batch_size]);
+                }
+                for(uint64_t i = 0; i < size; ++i)
+                {
+                    uint64_t hash = 0x9e3779b97f4a7c15ULL;
+                    for(uint64_t k = 0; k < width; ++k)
+                    {
+                        tuple[k] = keys[k * batch_size + i];
+                        hash = hashMix(hash ^ tuple[k]);
+                    }
+                    GroupTable<T>& table = local[hash >> (64 - partition_bits)];
+                    uint64_t entry = table.find(tuple.data(), hash);
+                    table.addRows(entry, 1);
+                    for(uint64_t v = 0; v < valueCount; ++v)
+                    {
+                        if (valid(validity[v], begin + i))
+                        {
+                            accumulate<T>(table.aggregate(entry, v), values[v][i]);
+                        }
+                    }
+                }
+            });
+        });
+
+        std::vector<GroupTable<T>> merged;
+        merged.reserve(partitions);
+        for(uint64_t p = 0; p < partitions; ++p)
+        {
+            merged.emplace_back(width, valueCount);
+        }
+        std::atomic<uint64_t> partition{0};
+        parallel(workersFor(partitions), [&](uint32_t) {
+            for(uint64_t p = partition.fetch_add(1); p < partitions; p = partition.fetch_add(1))
+            {
+                for(uint32_t w = 0; w < workers; ++w)
+                {
+                    merged[p].merge(tables[w][p]);
+                }
+            }
+        });
+
+        GroupByResult<T> result;
+        result.width = width;
+        result.values = valueCount;
+        for(GroupTable<T>& table : merged)
+        {
+            for(uint64_t entry = 0; entry < table.size(); ++entry)
+            {
+                result.keys.insert(result.keys.end(), table.key(entry), table.key(entry) + width);
+                result.rows.push_back(table.rows(entry));
+                for(uint64_t v = 0; v < valueCount; ++v)
+                {
+                    result.aggregates.push_back(table.aggregate(entry, v));
+                }
+            }
+        }
+        return result;
+    }
+};
+
+#endif // GROUPBY_H
@@ -0,0 +1,36 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <memory.h>
+#include <stdint.h>
+
+inline uint64_t hashMix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+inline uint64_t hashBytes(const char* data, uint64_t size)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ (size * 0x100000001b3ULL);
+    uint64_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ hashMix(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    if (i < size)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data + i, size - i);
+        hash = (hash ^ hashMix(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    return hashMix(hash);
+}
+
+#endif // HASH_H
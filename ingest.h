@@ -0,0 +1,464 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <memory.h>
+
+#include "column.h"
+#include "operators.h"
+#include "csv.h"
+#include "mappedfile.h"
+
+template<typename T>
+class BlockingQueue
+{
+private:
+    std::deque<T> _items;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _closed = false;
+public:
+    void push(T&& item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _items.push_back(std::move(item));
+        }
+        _cond.notify_one();
+    }
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [this] { return !_items.empty() || _closed; });
+        if (_items.empty())
+        {
+            return false;
+        }
+        item = std::move(_items.front());
+        _items.pop_front();
+        return true;
+    }
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _cond.notify_all();
+    }
+};
+
+struct Chunk
+{
+    uint64_t sequence = 0;
+    const char* data = nullptr;
+    uint64_t size = 0;
+};
+
+struct Segment
+{
+    uint64_t sequence = 0;
+    uint64_t rows = 0;
+    std::vector<std::vector<char>> values;
+    std::vector<std::vector<ByteBuffer>> cells;
+    std::vector<std::vector<ViewByteBuffer>> views;
+    // Rows of each fixed width column that parsed as empty and go in as nulls.
+    std::vector<std::vector<uint64_t>> nulls;
+};
+
+struct StageStats
+{
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+
+    double rowsPerSecond() const
+    {
+        return seconds > 0 ? rows / seconds : 0;
+    }
+};
+
+struct IngestStats
+{
+    uint64_t rows = 0;
+    uint64_t chunks = 0;
+    uint32_t workers = 0;
+    double seconds = 0;
+    StageStats read;
+    StageStats parse;
+    StageStats append;
+
+    friend std::ostream& operator<<(std::ostream& out, const IngestStats& ot)
+    {
+        out << "rows = " << ot.rows << " chunks = " << ot.chunks << " workers = " << ot.workers
+            << " wall = " << ot.seconds << "s" << std::endl;
+        out << "  read   " << ot.read.rowsPerSecond() << " rows/s (" << ot.read.seconds << "s, "
+            << ot.read.bytes << " bytes)" << std::endl;
+        out << "  parse  " << ot.parse.rowsPerSecond() << " rows/s (" << ot.parse.seconds << "s over all workers)" << std::endl;
+        out << "  append " << ot.append.rowsPerSecond() << " rows/s (" << ot.append.seconds << "s)" << std::endl;
+
+        return out;
+    }
+};
+
+class CsvIngest
+{
+private:
+    std::vector<std::unique_ptr<Column>>& _columns;
+    std::vector<std::shared_ptr<UnaryOperator>>& _casters;
+    char _separator;
+    uint64_t _chunkSize;
+    uint32_t _workers;
+    uint32_t _maxInflight;
+    std::vector<bool> _passthrough;
+    std::vector<uint64_t> _widths;
+    std::vector<IsNullable*> _nulls;
+
+    BlockingQueue<Chunk> _chunks;
+    BlockingQueue<Segment> _segments;
+
+    std::mutex _mutex;
+    std::condition_variable _slots;
+    uint32_t _inflight = 0;
+    uint32_t _activeWorkers = 0;
+    bool _failed = false;
+    std::exception_ptr _error;
+
+    IngestStats _stats;
+public:
+    CsvIngest(std::vector<std::unique_ptr<Column>>& columns,
+              std::vector<std::shared_ptr<UnaryOperator>>& casters,
+              char separator = ',',
+              uint64_t chunkSize = 16 * 1024 * 1024,
+              uint32_t workers = std::thread::hardware_concurrency())
+        :_columns(columns), _casters(casters), _separator(separator), _chunkSize(chunkSize)
+    {
+        _workers = workers > 0 ? workers : 1;
+        _maxInflight = _workers * 2;
+
+        for(auto& caster : _casters)
+        {
+            _passthrough.push_back(dynamic_cast<FromStringCast<StringType>*>(caster.get()) != nullptr);
+            _widths.push_back(caster->width());
+        }
+        for(auto& column : _columns)
+        {
+            IsNullable* nulls = dynamic_cast<IsNullable*>(column.get());
+            _nulls.push_back(nulls != nullptr && nulls->nullable() ? nulls : nullptr);
+        }
+    }
+    uint64_t read(const std::string& path, bool skipHeader = true)
+    {
+        MappedFile file(path);
+        const char* begin = file.data();
+        const char* end = file.data() + file.size();
+        if (skipHeader && begin != end)
+        {
+            CsvReader header(begin, file.size(), _separator);
+            header.skipLine();
+            begin = header.position();
+        }
+
+        _stats = IngestStats();
+        _stats.workers = _workers;
+        _inflight = 0;
+        _activeWorkers = _workers;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::thread reader(&CsvIngest::readChunks, this, begin, end);
+        std::vector<std::thread> workers;
+        for(uint32_t i = 0; i < _workers; ++i)
+        {
+            workers.emplace_back(&CsvIngest::parseChunks, this);
+        }
+
+        appendSegments();
+
+        reader.join();
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        _stats.seconds = std::chrono::duration<double>(stop - start).count();
+        _stats.read.rows = _stats.rows;
+
+        if (_error)
+        {
+            std::rethrow_exception(_error);
+        }
+
+        return _stats.rows;
+    }
+    const IngestStats& stats() const
+    {
+        return _stats;
+    }
+private:
+    void fail(std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_error)
+            {
+                _error = error;
+            }
+            _failed = true;
+        }
+        _slots.notify_all();
+        _chunks.close();
+        _segments.close();
+    }
+    bool acquireSlot()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _slots.wait(lock, [this] { return _inflight < _maxInflight || _failed; });
+        if (_failed)
+        {
+            return false;
+        }
+        _inflight++;
+        return true;
+    }
+    void releaseSlot()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _inflight--;
+        }
+        _slots.notify_one();
+    }
+    void readChunks(const char* begin, const char* end)
+    {
+        try {
+            StructuralScanner scanner(_separator);
+            uint64_t sequence = 0;
+
+            while(begin != end && acquireSlot())
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                const char* next = end;
+                if (static_cast<uint64_t>(end - begin) > _chunkSize)
+                {
+                    scanner.skip(begin, _chunkSize);
+                    next = begin + _chunkSize;
+                    next += scanner.rowEnd(next, static_cast<uint64_t>(end - next));
+                }
+
+                Chunk chunk;
+                chunk.sequence = sequence;
+                chunk.data = begin;
+                chunk.size = static_cast<uint64_t>(next - begin);
+                willNeed(chunk.data, chunk.size);
+
+                _stats.read.bytes += chunk.size;
+                auto stop = std::chrono::high_resolution_clock::now();
+                _stats.read.seconds += std::chrono::duration<double>(stop - start).count();
+
+                _chunks.push(std::move(chunk));
+                begin = next;
+                sequence++;
+            }
+
+            _chunks.close();
+        } catch(...)
+        {
+            fail(std::current_exception());
+        }
+    }
+    void willNeed(const char* data, uint64_t size)
+    {
+        uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+        uintptr_t first = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+        uintptr_t last = reinterpret_cast<uintptr_t>(data) + size;
+        ::madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+    }
+    void parseChunks()
+    {
+        try {
+            std::vector<ViewByteBuffer> cells;
+            double seconds = 0;
+            uint64_t rows = 0;
+
+            Chunk chunk;
+            while(_chunks.pop(chunk))
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                Segment segment;
+                segment.sequence = chunk.sequence;
+                segment.values.resize(_columns.size());
+                segment.cells.resize(_columns.size());
+                segment.views.resize(_columns.size());
+                segment.nulls.resize(_columns.size());
+
+                CsvReader reader(chunk.data, chunk.size, _separator);
+                while(reader.next(cells))
+                {
+                    if (cells.size() != _columns.size())
+                    {
+                        std::experimental::string_view line = reader.line();
+                        throw std::runtime_error("expected " + std::to_string(_columns.size()) + " cells, got "
+                                                 + std::to_string(cells.size()) + " " + std::string(line.data(), line.size()));
+                    }
+                    for(size_t i = 0; i < cells.size(); i++)
+                    {
+                        segment.views[i].push_back(cells[i]);
+                    }
+
+                    segment.rows++;
+                }
+
+                for(size_t i = 0; i < _columns.size(); i++)
+                {
+                    uint64_t done = segment.rows;
+                    try {
+                        if (_widths[i] > 0)
+                        {
+                            segment.values[i].resize(segment.rows * _widths[i]);
+
+                            char* values = segment.values[i].data();
+                            ParseStatus::type status = _casters[i]->parse(segment.views[i].data(), segment.rows, values, done);
+                            while(status == ParseStatus::EMPTY && _nulls[i] != nullptr)
+                            {
+                                segment.nulls[i].push_back(done);
+                                memset(values + done * _widths[i], 0, _widths[i]);
+                                uint64_t next = done + 1;
+                                status = _casters[i]->parse(segment.views[i].data() + next, segment.rows - next, values + next * _widths[i], done);
+                                done += next;
+                            }
+                            if (status != ParseStatus::OK)
+                            {
+                                throw std::invalid_argument(std::string(ParseStatus::name(status)) + " column " + std::to_string(i));
+                            }
+                            std::vector<ViewByteBuffer>().swap(segment.views[i]);
+                        }
+                        else if (!_passthrough[i])
+                        {
+                            for(done = 0; done < segment.rows; ++done)
+                            {
+                                segment.cells[i].push_back(_casters[i]->operation(segment.views[i][done]));
+                            }
+                            std::vector<ViewByteBuffer>().swap(segment.views[i]);
+                        }
+                    } catch(std::exception& ex)
+                    {
+                        std::experimental::string_view line = lineAt(chunk, done);
+                        throw std::runtime_error(std::string(ex.what()) + " " + std::string(line.data(), line.size()));
+                    }
+                }
+
+                rows += segment.rows;
+                _segments.push(std::move(segment));
+
+                auto stop = std::chrono::high_resolution_clock::now();
+                seconds += std::chrono::duration<double>(stop - start).count();
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.parse.seconds += seconds;
+            _stats.parse.rows += rows;
+        } catch(...)
+        {
+            fail(std::current_exception());
+        }
+
+        bool last = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            last = --_activeWorkers == 0;
+        }
+        if (last)
+        {
+            _segments.close();
+        }
+    }
+    std::experimental::string_view lineAt(Chunk& chunk, uint64_t row)
+    {
+        std::vector<ViewByteBuffer> cells;
+        CsvReader reader(chunk.data, chunk.size, _separator);
+        for(uint64_t i = 0; i <= row && reader.next(cells); ++i) {}
+
+        return reader.line();
+    }
+    void appendSegments()
+    {
+        std::map<uint64_t, Segment> pending;
+        uint64_t expected = 0;
+
+        Segment segment;
+        while(_segments.pop(segment))
+        {
+            pending.emplace(segment.sequence, std::move(segment));
+
+            auto next = pending.find(expected);
+            while(next != pending.end())
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                try {
+                    Segment& ready = next->second;
+                    for(size_t i = 0; i < _columns.size(); i++)
+                    {
+                        Column* column = _columns[i].get();
+                        if (_widths[i] > 0)
+                        {
+                            const char* values = ready.values[i].data();
+                            uint64_t begin = 0;
+                            for(uint64_t row : ready.nulls[i])
+                            {
+                                column->putBatch(values + begin * _widths[i], row - begin);
+                                _nulls[i]->putNull();
+                                begin = row + 1;
+                            }
+                            column->putBatch(values + begin * _widths[i], ready.rows - begin);
+                        }
+                        else if (_passthrough[i])
+                        {
+                            column->putBatch(ready.views[i].data(), ready.rows);
+                        }
+                        else
+                        {
+                            for(auto& cell : ready.cells[i])
+                            {
+                                column->put(cell);
+                            }
+                        }
+                    }
+                    _stats.rows += ready.rows;
+                    _stats.chunks++;
+                } catch(...)
+                {
+                    fail(std::current_exception());
+                    return;
+                }
+
+                auto stop = std::chrono::high_resolution_clock::now();
+                _stats.append.seconds += std::chrono::duration<double>(stop - start).count();
+
+                pending.erase(next);
+                releaseSlot();
+
+                expected++;
+                next = pending.find(expected);
+            }
+        }
+
+        _stats.append.rows = _stats.rows;
+    }
+};
+
+#endif // INGEST_H
@@ -0,0 +1,37 @@
+#ifndef ISA_H
+#define ISA_H
+
+struct Isa
+{
+    enum type
+    {
+        SCALAR = 0,
+        AVX2 = 1,
+        AVX512 = 2
+    };
+
+    static type detect()
+    {
+        static type selected = select();
+        return selected;
+    }
+private:
+    static type select()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+        {
+            return AVX512;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return AVX2;
+        }
+#endif
+        return SCALAR;
+    }
+};
+
+#endif // ISA_H
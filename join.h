@@ -0,0 +1,457 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "column.h"
+#include "groupby.h"
+#include "hash.h"
+#include "parallel.h"
+
+struct JoinType
+{
+    enum type
+    {
+        INNER = 0,
+        LEFT = 1
+    };
+};
+
+struct JoinInput
+{
+    enum type
+    {
+        LEFT = 0,
+        RIGHT = 1
+    };
+};
+
+// Key columns of one join input, each read as 64-bit words. A row with a null key matches nothing.
+class JoinKeys
+{
+private:
+    std::vector<std::unique_ptr<GroupKeys>> _keys;
+    std::vector<const ValidityBitmap*> _validity;
+    std::vector<TypeStore<DictStore>*> _dictionaries;
+public:
+    inline void key(TypedColumn<PlainStore, Int64Type>& column)
+    {
+        add(new ValueKeys<Int64Type>(column), nullptr, nullptr);
+    }
+    inline void key(NullableTypedColumn<PlainStore, Int64Type>& column)
+    {
+        add(new ValueKeys<Int64Type, NullableTypedColumn<PlainStore, Int64Type>>(column), &column.validity(), nullptr);
+    }
+    inline void key(TypedColumn<DictStore, StringType>& column)
+    {
+        add(new CodeKeys(column.dictionary()), nullptr, &column.dictionary());
+    }
+    inline void key(NullableTypedColumn<DictStore, StringType>& column)
+    {
+        add(new CodeKeys(column.dictionary()), &column.validity(), &column.dictionary());
+    }
+    inline uint64_t width() const
+    {
+        return _keys.size();
+    }
+    // Rows of the input; every key column must hold the same number.
+    inline uint64_t size()
+    {
+        uint64_t rows = _keys.empty() ? 0 : _keys[0]->size();
+        for(uint64_t i = 1; i < _keys.size(); ++i)
+        {
+            if (_keys[i]->size() != rows)
+            {
+                throw std::logic_error("key column " + std::to_string(i) + " holds " + std::to_string(_keys[i]->size()) + " rows, not " + std::to_string(rows));
+            }
+        }
+        return rows;
+    }
+    inline GroupKeys& keys(uint64_t column)
+    {
+        return *_keys[column];
+    }
+    // Validity bits of every row, or nullptr when the column has no nulls.
+    inline const uint64_t* validity(uint64_t column) const
+    {
+        return _validity[column] == nullptr ? nullptr : _validity[column]->words();
+    }
+    // The dictionary of a string key, or nullptr for an integer key.
+    inline TypeStore<DictStore>* dictionary(uint64_t column) const
+    {
+        return _dictionaries[column];
+    }
+private:
+    inline void add(GroupKeys* keys, const ValidityBitmap* validity, TypeStore<DictStore>* dictionary)
+    {
+        _keys.emplace_back(keys);
+        _validity.push_back(validity);
+        _dictionaries.push_back(dictionary);
+    }
+};
+
+// Matching row pairs of a join. An unmatched row of a LEFT join pairs with none.
+struct JoinResult
+{
+    static constexpr uint64_t none = std::numeric_limits<uint64_t>::max();
+
+    std::vector<uint64_t> left;
+    std::vector<uint64_t> right;
+
+    inline uint64_t size() const
+    {
+        return left.size();
+    }
+    // Appends the values of source at one input's rows of pairs [begin, begin + count) to target. Null
+    // values and unmatched rows append a null, so a LEFT join's right side needs a nullable target.
+    inline void materialize(JoinInput::type input, Column& source, Column& target, uint64_t begin = 0, uint64_t count = std::numeric_limits<uint64_t>::max()) const
+    {
+        const std::vector<uint64_t>& rows = input == JoinInput::LEFT ? left : right;
+        uint64_t end = begin < rows.size() && count < rows.size() - begin ? begin + count : rows.size();
+        if (begin < end)
+        {
+            gather(source, rows.data() + begin, end - begin, target);
+        }
+    }
+};
+
+// Equi-join of two inputs on their key columns, radix partitioned: both inputs are scattered by the
+// top hash bits into partitions sized so that the smaller input's part of one fits in cache, then
+// workers take a partition at a time, build a chained hash table over that part and probe it with
+// the other input's. String keys join on their dictionaries: codes of the dictionary with fewer
+// entries are translated into codes of the other. Pairs come out grouped by partition.
+class HashJoin
+{
+public:
+    static constexpr uint64_t batch_size = 1024;
+    static constexpr uint64_t partition_bytes = 256 * 1024;
+    static constexpr uint64_t max_partition_bits = 10;
+private:
+    static constexpr uint64_t missing = std::numeric_limits<uint64_t>::max();
+    static constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+
+    // Keyed rows of one input ordered by partition, and in row order within one.
+    struct Partitions
+    {
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> hashes;
+        std::vector<uint64_t> rows;
+        std::vector<uint64_t> keys;
+        // Rows with a null key or a string missing from the other input's dictionary, in row order.
+        std::vector<uint64_t> unkeyed;
+    };
+
+    JoinType::type _type;
+    uint32_t _workers;
+    JoinKeys _left;
+    JoinKeys _right;
+public:
+    explicit HashJoin(JoinType::type type = JoinType::INNER, uint32_t workers = std::thread::hardware_concurrency())
+        :_type(type), _workers(workers > 0 ? workers : 1) {}
+    inline JoinKeys& left()
+    {
+        return _left;
+    }
+    inline JoinKeys& right()
+    {
+        return _right;
+    }
+    JoinResult run()
+    {
+        uint64_t width = _left.width();
+        if (width == 0 || width != _right.width())
+        {
+            throw std::invalid_argument("join needs the same number of key columns on both inputs");
+        }
+        uint64_t leftRows = _left.size();
+        uint64_t rightRows = _right.size();
+        std::vector<std::vector<uint64_t>> leftCodes(width);
+        std::vector<std::vector<uint64_t>> rightCodes(width);
+        for(uint64_t k = 0; k < width; ++k)
+        {
+            TypeStore<DictStore>* left = _left.dictionary(k);
+            TypeStore<DictStore>* right = _right.dictionary(k);
+            if ((left == nullptr) != (right == nullptr))
+            {
+                throw std::invalid_argument("join key " + std::to_string(k) + " compares a string with an integer");
+            }
+            if (left == nullptr)
+            {
+                continue;
+            }
+            if (left->cardinality() <= right->cardinality())
+            {
+                leftCodes[k] = translate(*left, *right);
+            }
+            else
+            {
+                rightCodes[k] = translate(*right, *left);
+            }
+        }
+
+        bool buildLeft = leftRows < rightRows;
+        uint64_t buildBytes = (buildLeft ? leftRows : rightRows) * (width + 2) * sizeof(uint64_t);
+        uint64_t bits = 0;
+        while(bits < max_partition_bits && ((buildBytes >> bits) > partition_bytes || (_workers > 1 && (uint64_t(1) << bits) < uint64_t(_workers) * 4)))
+        {
+            bits++;
+        }
+
+        Partitions leftParts = partition(_left, leftCodes, leftRows, bits);
+        Partitions rightParts = partition(_right, rightCodes, rightRows, bits);
+        Partitions& build = buildLeft ? leftParts : rightParts;
+        Partitions& probe = buildLeft ? rightParts : leftParts;
+
+        uint64_t partitions = uint64_t(1) << bits;
+        std::vector<JoinResult> parts(partitions);
+        std::atomic<uint64_t> next{0};
+        parallel(workersFor(partitions, _workers), [&](uint32_t) {
+            std::vector<uint32_t> heads;
+            std::vector<uint32_t> chain;
+            std::vector<char> matched;
+            for(uint64_t p = next.fetch_add(1); p < partitions; p = next.fetch_add(1))
+            {
+                join(width, build, probe, p, buildLeft, parts[p], heads, chain, matched);
+            }
+        });
+
+        std::vector<uint64_t> offsets(partitions + 1, 0);
+        for(uint64_t p = 0; p < partitions; ++p)
+        {
+            offsets[p + 1] = offsets[p] + parts[p].size();
+        }
+        uint64_t unmatched = _type == JoinType::LEFT ? leftParts.unkeyed.size() : 0;
+        JoinResult result;
+        result.left.resize(offsets[partitions] + unmatched);
+        result.right.resize(offsets[partitions] + unmatched);
+        next = 0;
+        parallel(workersFor(partitions, _workers), [&](uint32_t) {
+            for(uint64_t p = next.fetch_add(1); p < partitions; p = next.fetch_add(1))
+            {
+                std::copy(parts[p].left.begin(), parts[p].left.end(), result.left.begin() + offsets[p]);
+                std::copy(parts[p].right.begin(), parts[p].right.end(), result.right.begin() + offsets[p]);
+                std::vector<uint64_t>().swap(parts[p].left);
+                std::vector<uint64_t>().swap(parts[p].right);
+            }
+        });
+        for(uint64_t i = 0; i < unmatched; ++i)
+        {
+            result.left[offsets[partitions] + i] = leftParts.unkeyed[i];
+            result.right[offsets[partitions] + i] = JoinResult::none;
+        }
+        return result;
+    }
+private:
+    // Codes of from mapped to the codes of the same strings in to, or to missing.
+    static inline std::vector<uint64_t> translate(TypeStore<DictStore>& from, TypeStore<DictStore>& to)
+    {
+        std::vector<uint64_t> codes(from.cardinality());
+        for(uint64_t code = 0; code < codes.size(); ++code)
+        {
+            ViewByteBuffer value = from.value(static_cast<uint32_t>(code));
+            int64_t found = to.find(value);
+            codes[code] = found < 0 ? missing : static_cast<uint64_t>(found);
+        }
+        return codes;
+    }
+    static inline uint64_t partitionOf(uint64_t hash, uint64_t bits)
+    {
+        return bits == 0 ? 0 : hash >> (64 - bits);
+    }
+    // Calls f(row, hash, key) for rows [begin, end) with key pointing at the row's width words, or
+    // nullptr when the row has no key.
+    template<typename F>
+    inline void scan(JoinKeys& input, const std::vector<std::vector<uint64_t>>& codes, uint64_t begin, uint64_t end, F f)
+    {
+        uint64_t width = input.width();
+        std::vector<uint64_t> keys(width * batch_size);
+        std::vector<uint64_t> tuple(width);
+        std::vector<const uint64_t*> validity(width);
+        for(uint64_t k = 0; k < width; ++k)
+        {
+            validity[k] = input.validity(k);
+        }
+
+        for(uint64_t batch = begin; batch < end; batch += batch_size)
+        {
+            uint64_t count = end - batch < batch_size ? end - batch : batch_size;
+            for(uint64_t k = 0; k < width; ++k)
+            {
+                uint64_t* column = &keys[k * batch_size];
+                input.keys(k).read(batch, count, column);
+                if (!codes[k].empty())
+                {
+                    for(uint64_t i = 0; i < count; ++i)
+                    {
+                        column[i] = codes[k][column[i]];
+                    }
+                }
+            }
+            for(uint64_t i = 0; i < count; ++i)
+            {
+                uint64_t row = batch + i;
+                uint64_t hash = 0x9e3779b97f4a7c15ULL;
+                bool keyed = true;
+                for(uint64_t k = 0; k < width; ++k)
+                {
+                    tuple[k] = keys[k * batch_size + i];
+                    keyed &= validity[k] == nullptr || ((validity[k][row / 64] >> (row % 64)) & 1) != 0;
+                    keyed &= codes[k].empty() || tuple[k] != missing;
+                    hash = hashMix(hash ^ tuple[k]);
+                }
+                f(row, hash, keyed ? tuple.data() : nullptr);
+            }
+        }
+    }
+    // Two passes over each worker's share of rows: one counts rows per partition, the other
+    // scatters them to their partition's slice for that worker.
+    Partitions partition(JoinKeys& input, const std::vector<std::vector<uint64_t>>& codes, uint64_t rows, uint64_t bits)
+    {
+        uint64_t width = input.width();
+        uint64_t partitions = uint64_t(1) << bits;
+        uint32_t workers = workersFor(rows / (64 * batch_size) + 1, _workers);
+        std::vector<std::vector<uint64_t>> positions(workers, std::vector<uint64_t>(partitions, 0));
+        std::vector<std::vector<uint64_t>> unkeyed(workers);
+
+        parallel(workers, [&](uint32_t w) {
+            std::vector<uint64_t>& histogram = positions[w];
+            scan(input, codes, rows * w / workers, rows * (w + 1) / workers, [&](uint64_t row, uint64_t hash, const uint64_t* key) {
+                if (key == nullptr)
+                {
+                    unkeyed[w].push_back(row);
+                    return;
+                }
+                histogram[partitionOf(hash, bits)]++;
+            });
+        });
+
+        Partitions parts;
+        parts.offsets.resize(partitions + 1);
+        uint64_t total = 0;
+        for(uint64_t p = 0; p < partitions; ++p)
+        {
+            parts.offsets[p] = total;
+            for(uint32_t w = 0; w < workers; ++w)
+            {
+                uint64_t count = positions[w][p];
+                positions[w][p] = total;
+                total += count;
+            }
+        }
+        parts.offsets[partitions] = total;
+        parts.hashes.resize(total);
+        parts.rows.resize(total);
+        parts.keys.resize(total * width);
+
+        parallel(workers, [&](uint32_t w) {
+            std::vector<uint64_t>& position = positions[w];
+            scan(input, codes, rows * w / workers, rows * (w + 1) / workers, [&](uint64_t row, uint64_t hash, const uint64_t* key) {
+                if (key == nullptr)
+                {
+                    return;
+                }
+                uint64_t slot = position[partitionOf(hash, bits)]++;
+                parts.hashes[slot] = hash;
+                parts.rows[slot] = row;
+                memcpy(&parts.keys[slot * width], key, width * sizeof(uint64_t));
+            });
+        });
+
+        for(uint32_t w = 0; w < workers; ++w)
+        {
+            parts.unkeyed.insert(parts.unkeyed.end(), unkeyed[w].begin(), unkeyed[w].end());
+        }
+        return parts;
+    }
+    // Joins partition p: a bucket chained table over the build part, probed in the probe part's
+    // row order. Chains link build rows in row order, so matches of one probe row come out so too.
+    inline void join(uint64_t width, Partitions& build, Partitions& probe, uint64_t p, bool buildLeft, JoinResult& out,
+                     std::vector<uint32_t>& heads, std::vector<uint32_t>& chain, std::vector<char>& matched)
+    {
+        uint64_t first = build.offsets[p];
+        uint64_t size = build.offsets[p + 1] - first;
+        if (size >= empty)
+        {
+            throw std::length_error("join partition of " + std::to_string(size) + " rows");
+        }
+        uint64_t buckets = 1;
+        while(buckets < size)
+        {
+            buckets <<= 1;
+        }
+        uint64_t mask = buckets - 1;
+        heads.assign(buckets, empty);
+        chain.resize(size);
+        for(uint64_t i = size; i-- > 0;)
+        {
+            uint64_t bucket = build.hashes[first + i] & mask;
+            chain[i] = heads[bucket];
+            heads[bucket] = static_cast<uint32_t>(i);
+        }
+
+        bool outerProbe = _type == JoinType::LEFT && !buildLeft;
+        bool outerBuild = _type == JoinType::LEFT && buildLeft;
+        if (outerBuild)
+        {
+            matched.assign(size, 0);
+        }
+        std::vector<uint64_t>& buildRows = buildLeft ? out.left : out.right;
+        std::vector<uint64_t>& probeRows = buildLeft ? out.right : out.left;
+        for(uint64_t j = probe.offsets[p]; j < probe.offsets[p + 1]; ++j)
+        {
+            uint64_t hash = probe.hashes[j];
+            const uint64_t* key = &probe.keys[j * width];
+            bool found = false;
+            for(uint32_t i = heads[hash & mask]; i != empty; i = chain[i])
+            {
+                if (build.hashes[first + i] != hash || !equal(&build.keys[(first + i) * width], key, width))
+                {
+                    continue;
+                }
+                found = true;
+                buildRows.push_back(build.rows[first + i]);
+                probeRows.push_back(probe.rows[j]);
+                if (outerBuild)
+                {
+                    matched[i] = 1;
+                }
+            }
+            if (!found && outerProbe)
+            {
+                out.left.push_back(probe.rows[j]);
+                out.right.push_back(JoinResult::none);
+            }
+        }
+        if (outerBuild)
+        {
+            for(uint64_t i = 0; i < size; ++i)
+            {
+                if (matched[i] == 0)
+                {
+                    out.left.push_back(build.rows[first + i]);
+                    out.right.push_back(JoinResult::none);
+                }
+            }
+        }
+    }
+    static inline bool equal(const uint64_t* left, const uint64_t* right, uint64_t width)
+    {
+        for(uint64_t k = 0; k < width; ++k)
+        {
+            if (left[k] != right[k])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // JOIN_H
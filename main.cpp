@@ -4,22 +4,22 @@
 #include <algorithm>
 
 #include "column.h"
+#include "adaptive.h"
+#include "table.h"
 #include "operators.h"
 #include "value.h"
+#include "ingest.h"
 
 using namespace std;
 
-void split(vector<experimental::string_view>& results, string const& original, char separator);
-
-int main()
+int main(int argc, char* argv[])
 {
-    std::vector<std::unique_ptr<Column>> columns;
-    columns.push_back(std::make_unique<TypedColumn<PlainStore, Int64Type>>());
-    columns.push_back(std::make_unique<TypedColumn<PlainStore, StringType>>());
+    Table table(Schema{
+        {"id", Type::INT64, Encoding::ADAPTIVE, false},
+        {"name", Type::STRING, Encoding::ADAPTIVE, false}
+    });
 
-    std::vector<std::shared_ptr<UnaryOperator>> casters2Type;
-    casters2Type.push_back(std::make_shared<FromStringCast<Int64Type>>());
-    casters2Type.push_back(std::make_shared<FromStringCast<StringType>>());
+    std::vector<std::shared_ptr<UnaryOperator>> casters2Type = table.casters();
 
     std::vector<std::shared_ptr<UnaryOperator>> casters2String;
     casters2String.push_back(std::make_shared<ToStringCast<Int64Type>>());
@@ -27,42 +27,36 @@ int main()
 
     chrono::time_point<std::chrono::high_resolution_clock> start, end;
 
-    fstream input("/home/andrei/Desktop/MC5Dau.csv");
-    string line;
-    line.reserve(1024 * 1024);
-
-    vector<experimental::string_view> piece;
+    string path = argc > 1 ? argv[1] : "/home/andrei/Desktop/MC5Dau.csv";
+    CsvIngest ingest(table.columns(), casters2Type, ',');
 
-    uint32_t counter = 0;
     {
         start = chrono::high_resolution_clock::now();
 
-        getline(input, line);
-        while(getline(input, line))
+        try {
+            ingest.read(path);
+        } catch(exception& ex)
         {
-            split(piece, line, ',');
-            for(size_t i = 0; i < piece.size(); i++)
-            {
-                try {
-                    experimental::string_view* value = &piece.at(i);
-                    ViewByteBuffer val(value->size(), value->data());
-                    ByteBuffer buffer = casters2Type.at(i)->operation(val);
-                    columns.at(i)->put(buffer);
-                } catch(exception& ex)
-                {
-                    cout << __FILE__ << __LINE__ << ex.what() << " " << line << endl;
-                    abort();
-                }
-            }
-
-            piece.clear();
-            counter++;
+            cout << __FILE__ << __LINE__ << ex.what() << endl;
+            abort();
         }
 
         end = chrono::high_resolution_clock::now();
         chrono::duration<double> elapsed_time = end - start;
 
-        cout << counter << " read duration = " << elapsed_time.count() << "s" << std::endl;
+        cout << table.size() << " read duration = " << elapsed_time.count() << "s" << std::endl;
+        cout << ingest.stats();
+        table.flush();
+        for(uint64_t i = 0; i < table.columnCount(); ++i)
+        {
+            AdaptiveColumn* column = static_cast<AdaptiveColumn*>(&table.column(i));
+            cout << "column " << table.schema().field(i).name << " memory = " << column->memoryUsage() << " bytes, segments =";
+            for(uint64_t s = 0; s < column->segmentCount(); ++s)
+            {
+                cout << " " << column->segmentStart(s) << ":" << column->segmentEncoding(s);
+            }
+            cout << endl;
+        }
     }
 
 //    ofstream out("/home/andrei/Desktop/output.csv");
@@ -70,49 +64,24 @@ int main()
 //    {
 //        start = chrono::high_resolution_clock::now();
 
-//        for(uint64_t i = 0; i < counter; ++i)
+//        for(uint64_t i = 0; i < table.size(); ++i)
 //        {
-//            for(uint64_t j = 0; j < (columns.size() - 1); ++j)
+//            for(uint64_t j = 0; j < (table.columnCount() - 1); ++j)
 //            {
-//                ViewByteBuffer val = columns.at(j)->getView(i);
+//                ViewByteBuffer val = table.column(j).getView(i);
 //                out << casters2String.at(j)->operation(val) << ",";
 //            }
-//            ViewByteBuffer val = columns.at(columns.size() - 1)->getView(i);
-//            out << casters2String.at(columns.size() - 1)->operation(val) << endl;
+//            ViewByteBuffer val = table.column(table.columnCount() - 1).getView(i);
+//            out << casters2String.at(table.columnCount() - 1)->operation(val) << endl;
 //        }
 
 //        end = chrono::high_resolution_clock::now();
 //        chrono::duration<double> elapsed_time = end - start;
 
-//        cout << counter << " write duration = " << elapsed_time.count() << "s" << std::endl;
+//        cout << table.size() << " write duration = " << elapsed_time.count() << "s" << std::endl;
 //    }
 
 //    out.close();
 
     return 0;
 }
-
-void split(vector<experimental::string_view>& results, string const& original, char separator)
-{
-    string::const_iterator start = original.begin();
-    string::const_iterator end = original.end();
-    string::const_iterator next = find(start, end, separator);
-    while(next != end && *start == '"' && *(next-1) != '"')
-    {
-        next = find(next + 1, end, separator);
-    }
-    while (next != end) {
-        experimental::string_view str(start.operator ->(), static_cast<uint64_t>(next.operator ->() - start.operator ->()));
-        results.push_back(str);
-
-        start = next + 1;
-        next = find(start, end, separator);
-        while(*start == '"' && *(next-1) != '"' && next != end)
-        {
-            next = find(next + 1, end, separator);
-        }
-    }
-
-    experimental::string_view str(start.operator ->(), static_cast<uint64_t>(next.operator ->() - start.operator ->()));
-    results.push_back(str);
-}
@@ -0,0 +1,72 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class MappedFile
+{
+private:
+    int _fd = -1;
+    char* _data = nullptr;
+    uint64_t _size = 0;
+public:
+    explicit MappedFile(const std::string& path, int advice = MADV_SEQUENTIAL)
+    {
+        _fd = ::open(path.c_str(), O_RDONLY);
+        if (_fd < 0)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+
+        struct stat info;
+        if (::fstat(_fd, &info) != 0)
+        {
+            ::close(_fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+        _size = static_cast<uint64_t>(info.st_size);
+
+        if (_size > 0)
+        {
+            void* data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(_fd);
+                throw std::runtime_error("cannot mmap " + path);
+            }
+            _data = static_cast<char*>(data);
+            ::madvise(_data, _size, advice);
+        }
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+        if (_data != nullptr)
+        {
+            ::munmap(_data, _size);
+            _data = nullptr;
+        }
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+        _size = 0;
+    }
+    inline const char* data() const
+    {
+        return _data;
+    }
+    inline uint64_t size() const
+    {
+        return _size;
+    }
+};
+
+#endif // MAPPEDFILE_H
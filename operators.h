@@ -2,153 +2,200 @@
 #define OPERATORS_H
 
 #include <string>
-#include <boost/spirit/include/qi_parse.hpp>
-#include <boost/spirit/include/qi_numeric.hpp>
+#include <charconv>
+#include <stdexcept>
 
 #include "types.h"
 #include "bytebuffer.h"
+#include "column.h"
 
-class UnaryOperator
+struct ParseStatus
 {
-public:
-    virtual ~UnaryOperator() {}
-    virtual ByteBuffer operation(ByteBuffer &value) = 0;
-    virtual ByteBuffer operation(ViewByteBuffer &value) = 0;
+    enum type
+    {
+        OK = 0,
+        EMPTY = 1,
+        INVALID = 2,
+        OUT_OF_RANGE = 3,
+        UNSUPPORTED = 4
+    };
+
+    static const char* name(type status)
+    {
+        switch(status)
+        {
+        case OK: return "OK";
+        case EMPTY: return "EMPTY";
+        case INVALID: return "INVALID";
+        case OUT_OF_RANGE: return "OUT_OF_RANGE";
+        default: return "UNSUPPORTED";
+        }
+    }
 };
 
 template<typename T>
-class FromStringCast: public UnaryOperator
+inline ParseStatus::type parseValue(const char* data, uint64_t size, typename T::c_type& out)
 {
-public:
-    ByteBuffer operation(ByteBuffer &value) override
+    const char* begin = data;
+    const char* end = data + size;
+    while(begin != end && (*begin == ' ' || *begin == '\t'))
     {
-        throw;
+        ++begin;
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    while(end != begin && (*(end - 1) == ' ' || *(end - 1) == '\t' || *(end - 1) == '\r'))
     {
-        throw;
+        --end;
     }
-};
-
-template<>
-class FromStringCast<Int8Type>: public UnaryOperator
-{
-public:
-    ByteBuffer operation(ByteBuffer &value) override
+    if (begin != end && *begin == '+' && (end - begin) > 1 && *(begin + 1) != '-')
     {
-        std::string str(value._data, value._size);
-        int8_t cast_value = static_cast<int8_t>(std::stoi(str));
-
-        return ByteBuffer(sizeof(int8_t), reinterpret_cast<char*>(&cast_value));
+        ++begin;
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    if (begin == end)
     {
-        std::string str(value._data, value._size);
-        int8_t cast_value = static_cast<int8_t>(std::stoi(str));
-
-        return ByteBuffer(sizeof(int8_t), reinterpret_cast<char*>(&cast_value));
+        return ParseStatus::EMPTY;
     }
-};
 
-template<>
-class FromStringCast<Int16Type>: public UnaryOperator
-{
-public:
-    ByteBuffer operation(ByteBuffer &value) override
+    std::from_chars_result result = std::from_chars(begin, end, out);
+    if (result.ec == std::errc::result_out_of_range)
     {
-        std::string str(value._data, value._size);
-        int16_t cast_value = static_cast<int16_t>(std::stoi(str));
-
-        return ByteBuffer(sizeof(int16_t), reinterpret_cast<char*>(&cast_value));
+        return ParseStatus::OUT_OF_RANGE;
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    if (result.ec != std::errc() || result.ptr != end)
     {
-        std::string str(value._data, value._size);
-        int16_t cast_value = static_cast<int16_t>(std::stoi(str));
-
-        return ByteBuffer(sizeof(int16_t), reinterpret_cast<char*>(&cast_value));
+        return ParseStatus::INVALID;
     }
-};
 
-template<>
-class FromStringCast<Int32Type>: public UnaryOperator
+    return ParseStatus::OK;
+}
+
+class UnaryOperator
 {
 public:
-    ByteBuffer operation(ByteBuffer &value) override
+    virtual ~UnaryOperator() {}
+    virtual ByteBuffer operation(ByteBuffer &value) = 0;
+    virtual ByteBuffer operation(ViewByteBuffer &value) = 0;
+    virtual uint64_t width()
     {
-        std::string str(value._data, value._size);
-        int32_t cast_value = std::stoi(str);
-
-        return ByteBuffer(sizeof(int32_t), reinterpret_cast<char*>(&cast_value));
+        return 0;
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    virtual ParseStatus::type parse(ViewByteBuffer &value, char* out)
     {
-        std::string str(value._data, value._size);
-        int32_t cast_value = std::stoi(str);
+        return ParseStatus::UNSUPPORTED;
+    }
+    virtual ParseStatus::type parse(ViewByteBuffer &value, Column &out)
+    {
+        return ParseStatus::UNSUPPORTED;
+    }
+    virtual ParseStatus::type parse(ViewByteBuffer* values, uint64_t count, char* out, uint64_t &done)
+    {
+        done = 0;
+        return ParseStatus::UNSUPPORTED;
+    }
+    virtual ParseStatus::type operation(ViewByteBuffer* values, uint64_t count, Column &out, uint64_t &done)
+    {
+        for(done = 0; done < count; ++done)
+        {
+            ByteBuffer value = operation(values[done]);
+            out.put(value);
+        }
 
-        return ByteBuffer(sizeof(int32_t), reinterpret_cast<char*>(&cast_value));
+        return ParseStatus::OK;
     }
 };
 
-template<>
-class FromStringCast<Int64Type>: public UnaryOperator
+template<typename T>
+class FromStringCast: public UnaryOperator
 {
+private:
+    typedef typename T::c_type c_type;
 public:
     ByteBuffer operation(ByteBuffer &value) override
     {
-        std::experimental::string_view str(value._data, value._size);
-        int64_t cast_value = 0;
-        boost::spirit::qi::parse(str.begin(), str.end(), boost::spirit::qi::long_, cast_value);
-
-        return ByteBuffer(sizeof(int64_t), reinterpret_cast<char*>(&cast_value));
+        ViewByteBuffer view(value);
+        return operation(view);
     }
     ByteBuffer operation(ViewByteBuffer &value) override
     {
-        std::experimental::string_view str(value._data, value._size);
-        int64_t cast_value = 0;
-        boost::spirit::qi::parse(str.begin(), str.end(), boost::spirit::qi::long_, cast_value);
+        c_type cast_value = c_type();
+        check(parseValue<T>(value._data, value._size, cast_value), value);
 
-        return ByteBuffer(sizeof(int64_t), reinterpret_cast<char*>(&cast_value));
+        return ByteBuffer(sizeof(c_type), reinterpret_cast<char*>(&cast_value));
     }
-};
-
-template<>
-class FromStringCast<FloatType>: public UnaryOperator
-{
-public:
-    ByteBuffer operation(ByteBuffer &value) override
+    uint64_t width() override
     {
-        std::string str(value._data, value._size);
-        float cast_value = std::stof(str);
-
-        return ByteBuffer(sizeof(float), reinterpret_cast<char*>(&cast_value));
+        return sizeof(c_type);
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    ParseStatus::type parse(ViewByteBuffer &value, char* out) override
     {
-        std::string str(value._data, value._size);
-        float cast_value = std::stof(str);
+        c_type cast_value = c_type();
+        ParseStatus::type status = parseValue<T>(value._data, value._size, cast_value);
+        memcpy(out, &cast_value, sizeof(c_type));
 
-        return ByteBuffer(sizeof(float), reinterpret_cast<char*>(&cast_value));
+        return status;
     }
-};
+    ParseStatus::type parse(ViewByteBuffer &value, Column &out) override
+    {
+        c_type cast_value = c_type();
+        ParseStatus::type status = parseValue<T>(value._data, value._size, cast_value);
+        if (status == ParseStatus::OK)
+        {
+            ViewByteBuffer slot(sizeof(c_type), reinterpret_cast<char*>(&cast_value));
+            out.put(slot);
+        }
 
-template<>
-class FromStringCast<DoubleType>: public UnaryOperator
-{
-public:
-    ByteBuffer operation(ByteBuffer &value) override
+        return status;
+    }
+    ParseStatus::type parse(ViewByteBuffer* values, uint64_t count, char* out, uint64_t &done) override
     {
-        std::string str(value._data, value._size);
-        double cast_value = std::stod(str);
+        c_type* slots = reinterpret_cast<c_type*>(out);
+        for(done = 0; done < count; ++done)
+        {
+            c_type cast_value = c_type();
+            ParseStatus::type status = parseValue<T>(values[done]._data, values[done]._size, cast_value);
+            if (status != ParseStatus::OK)
+            {
+                return status;
+            }
+            memcpy(&slots[done], &cast_value, sizeof(c_type));
+        }
 
-        return ByteBuffer(sizeof(double), reinterpret_cast<char*>(&cast_value));
+        return ParseStatus::OK;
     }
-    ByteBuffer operation(ViewByteBuffer &value) override
+    ParseStatus::type operation(ViewByteBuffer* values, uint64_t count, Column &out, uint64_t &done) override
     {
-        std::string str(value._data, value._size);
-        double cast_value = std::stod(str);
+        c_type batch[batch_size];
+        done = 0;
 
-        return ByteBuffer(sizeof(double), reinterpret_cast<char*>(&cast_value));
+        while(done < count)
+        {
+            uint64_t size = count - done < batch_size ? count - done : batch_size;
+            uint64_t parsed = 0;
+            ParseStatus::type status = parse(values + done, size, reinterpret_cast<char*>(batch), parsed);
+
+            out.putBatch(reinterpret_cast<char*>(batch), parsed);
+            done += parsed;
+
+            if (status != ParseStatus::OK)
+            {
+                return status;
+            }
+        }
+
+        return ParseStatus::OK;
+    }
+private:
+    static constexpr uint64_t batch_size = 1024;
+
+    static void check(ParseStatus::type status, ViewByteBuffer &value)
+    {
+        if (status == ParseStatus::OUT_OF_RANGE)
+        {
+            throw std::out_of_range(std::string(T::name) + " " + std::string(value._data, value._size));
+        }
+        if (status != ParseStatus::OK)
+        {
+            throw std::invalid_argument(std::string(T::name) + " " + std::string(value._data, value._size));
+        }
     }
 };
 
@@ -164,6 +211,19 @@ public:
     {
         return ByteBuffer(value._size, value._data);
     }
+    ParseStatus::type parse(ViewByteBuffer &value, Column &out) override
+    {
+        out.put(value);
+
+        return ParseStatus::OK;
+    }
+    ParseStatus::type operation(ViewByteBuffer* values, uint64_t count, Column &out, uint64_t &done) override
+    {
+        out.putBatch(values, count);
+        done = count;
+
+        return ParseStatus::OK;
+    }
 };
 
 template<typename T>
@@ -314,4 +374,23 @@ public:
     }
 };
 
+inline std::shared_ptr<UnaryOperator> makeFromStringCast(Type::type type)
+{
+    switch(type)
+    {
+    case Type::UINT8: return std::make_shared<FromStringCast<UInt8Type>>();
+    case Type::INT8: return std::make_shared<FromStringCast<Int8Type>>();
+    case Type::UINT16: return std::make_shared<FromStringCast<UInt16Type>>();
+    case Type::INT16: return std::make_shared<FromStringCast<Int16Type>>();
+    case Type::UINT32: return std::make_shared<FromStringCast<UInt32Type>>();
+    case Type::INT32: return std::make_shared<FromStringCast<Int32Type>>();
+    case Type::UINT64: return std::make_shared<FromStringCast<UInt64Type>>();
+    case Type::INT64: return std::make_shared<FromStringCast<Int64Type>>();
+    case Type::FLOAT: return std::make_shared<FromStringCast<FloatType>>();
+    case Type::DOUBLE: return std::make_shared<FromStringCast<DoubleType>>();
+    case Type::STRING: return std::make_shared<FromStringCast<StringType>>();
+    }
+    throw std::invalid_argument("unknown type " + std::to_string(type));
+}
+
 #endif // OPERATORS_H
@@ -0,0 +1,53 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <stdint.h>
+
+// Runs task(worker) for every worker in [0, workers) on a thread of its own and rethrows the first
+// failure once all of them have finished.
+template<typename F>
+inline void parallel(uint32_t workers, F task)
+{
+    if (workers == 1)
+    {
+        task(0);
+        return;
+    }
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> threads;
+    for(uint32_t w = 0; w < workers; ++w)
+    {
+        threads.emplace_back([&, w]() {
+            try {
+                task(w);
+            } catch(...)
+            {
+                if (!failed.exchange(true))
+                {
+                    error = std::current_exception();
+                }
+            }
+        });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+// No more workers than tasks, and at least one.
+inline uint32_t workersFor(uint64_t tasks, uint32_t workers)
+{
+    return tasks < workers ? static_cast<uint32_t>(tasks > 0 ? tasks : 1) : workers;
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,238 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <vector>
+#include <memory.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "isa.h"
+
+struct StructuralMasks
+{
+    uint64_t quotes;
+    uint64_t separators;
+    uint64_t newlines;
+};
+
+typedef void (*MasksKernel)(const char* data, uint64_t blocks, char separator, StructuralMasks* masks);
+
+inline void scalarMasks(const char* data, uint64_t blocks, char separator, StructuralMasks* masks)
+{
+    for(uint64_t b = 0; b < blocks; ++b)
+    {
+        const char* block = data + b * 64;
+        uint64_t quotes = 0;
+        uint64_t separators = 0;
+        uint64_t newlines = 0;
+        for(uint64_t i = 0; i < 64; ++i)
+        {
+            quotes |= static_cast<uint64_t>(block[i] == '"') << i;
+            separators |= static_cast<uint64_t>(block[i] == separator) << i;
+            newlines |= static_cast<uint64_t>(block[i] == '\n') << i;
+        }
+        masks[b].quotes = quotes;
+        masks[b].separators = separators;
+        masks[b].newlines = newlines;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+inline uint64_t avx2Compare(__m256i lo, __m256i hi, __m256i needle)
+{
+    uint64_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    uint64_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return low | (high << 32);
+}
+
+__attribute__((target("avx2")))
+inline void avx2Masks(const char* data, uint64_t blocks, char separator, StructuralMasks* masks)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i comma = _mm256_set1_epi8(separator);
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    for(uint64_t b = 0; b < blocks; ++b)
+    {
+        const char* block = data + b * 64;
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+        masks[b].quotes = avx2Compare(lo, hi, quote);
+        masks[b].separators = avx2Compare(lo, hi, comma);
+        masks[b].newlines = avx2Compare(lo, hi, newline);
+    }
+}
+#endif
+
+inline uint64_t prefixXor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+class StructuralScanner
+{
+private:
+    static constexpr uint64_t window_blocks = 64;
+
+    char _separator;
+    uint64_t _inQuote = 0;
+    MasksKernel _kernel;
+public:
+    explicit StructuralScanner(char separator = ','):_separator(separator)
+    {
+        _kernel = kernel();
+    }
+    static MasksKernel kernel()
+    {
+        static MasksKernel selected = select();
+        return selected;
+    }
+    static const char* isa()
+    {
+        return kernel() == &scalarMasks ? "scalar" : "avx2";
+    }
+    inline void reset()
+    {
+        _inQuote = 0;
+    }
+    inline bool inQuote() const
+    {
+        return _inQuote != 0;
+    }
+    // Calls onMark(offset, newline) for every separator and newline outside quotes, in order.
+    // Returning false from onMark stops the scan; the quote state is then left undefined.
+    template<typename F>
+    inline bool scan(const char* data, uint64_t size, F&& onMark)
+    {
+        StructuralMasks masks[window_blocks];
+        uint64_t offset = 0;
+
+        while(offset < size)
+        {
+            uint64_t blocks = (size - offset) / 64;
+            if (blocks > window_blocks)
+            {
+                blocks = window_blocks;
+            }
+
+            if (blocks > 0)
+            {
+                _kernel(data + offset, blocks, _separator, masks);
+            }
+            else
+            {
+                char tail[64] = {};
+                memcpy(tail, data + offset, size - offset);
+                _kernel(tail, 1, _separator, masks);
+                blocks = 1;
+            }
+
+            for(uint64_t b = 0; b < blocks; ++b)
+            {
+                uint64_t inside = prefixXor(masks[b].quotes) ^ _inQuote;
+                _inQuote = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+
+                uint64_t newlines = masks[b].newlines & ~inside;
+                uint64_t structural = (masks[b].separators & ~inside) | newlines;
+                while(structural != 0)
+                {
+                    uint64_t bit = static_cast<uint64_t>(__builtin_ctzll(structural));
+                    uint64_t position = offset + b * 64 + bit;
+                    if (position >= size)
+                    {
+                        break;
+                    }
+                    if (!onMark(position, ((newlines >> bit) & 1) != 0))
+                    {
+                        return false;
+                    }
+                    structural &= structural - 1;
+                }
+            }
+
+            offset += blocks * 64;
+        }
+
+        return true;
+    }
+    // Advances the quote state over data without reporting any marks.
+    inline void skip(const char* data, uint64_t size)
+    {
+        StructuralMasks masks[window_blocks];
+        uint64_t offset = 0;
+
+        while(offset < size)
+        {
+            uint64_t blocks = (size - offset) / 64;
+            if (blocks > window_blocks)
+            {
+                blocks = window_blocks;
+            }
+
+            if (blocks > 0)
+            {
+                _kernel(data + offset, blocks, _separator, masks);
+            }
+            else
+            {
+                char tail[64] = {};
+                memcpy(tail, data + offset, size - offset);
+                _kernel(tail, 1, _separator, masks);
+                blocks = 1;
+            }
+
+            for(uint64_t b = 0; b < blocks; ++b)
+            {
+                _inQuote ^= -static_cast<uint64_t>(__builtin_popcountll(masks[b].quotes) & 1);
+            }
+
+            offset += blocks * 64;
+        }
+    }
+    // Appends (offset << 1 | newline) relative to base for every structural character.
+    inline void index(const char* data, uint64_t size, uint64_t base, std::vector<uint64_t>& marks)
+    {
+        scan(data, size, [&marks, base](uint64_t position, bool newline) {
+            marks.push_back(((base + position) << 1) | static_cast<uint64_t>(newline));
+            return true;
+        });
+    }
+    // Returns the offset just past the first newline outside quotes, or size when there is none.
+    inline uint64_t rowEnd(const char* data, uint64_t size)
+    {
+        uint64_t end = size;
+        scan(data, size, [&end](uint64_t position, bool newline) {
+            if (newline)
+            {
+                end = position + 1;
+                return false;
+            }
+            return true;
+        });
+        _inQuote = 0;
+        return end;
+    }
+private:
+    static MasksKernel select()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (Isa::detect() >= Isa::AVX2)
+        {
+            return &avx2Masks;
+        }
+#endif
+        return &scalarMasks;
+    }
+};
+
+#endif // SCANNER_H
@@ -0,0 +1,537 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <memory.h>
+
+#include "column.h"
+#include "parallel.h"
+
+struct SortOrder
+{
+    enum type
+    {
+        ASCENDING = 0,
+        DESCENDING = 1
+    };
+};
+
+// Unsigned keys that order like the values: signed integers get their sign bit flipped, floats
+// all bits when negative and the sign bit otherwise, which puts NaNs past infinity.
+template<typename V>
+inline typename std::enable_if<std::is_integral<V>::value, uint64_t>::type orderKey(V value)
+{
+    typedef typename std::make_unsigned<V>::type unsigned_type;
+    unsigned_type bits = static_cast<unsigned_type>(value);
+    if (std::is_signed<V>::value)
+    {
+        bits ^= static_cast<unsigned_type>(unsigned_type(1) << (sizeof(V) * 8 - 1));
+    }
+    return bits;
+}
+inline uint64_t orderKey(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000U) != 0 ? ~bits : bits | 0x80000000U;
+}
+inline uint64_t orderKey(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x8000000000000000ULL) != 0 ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+template<typename V>
+inline typename std::enable_if<std::is_integral<V>::value, V>::type fromOrderKey(uint64_t key)
+{
+    typedef typename std::make_unsigned<V>::type unsigned_type;
+    unsigned_type bits = static_cast<unsigned_type>(key);
+    if (std::is_signed<V>::value)
+    {
+        bits ^= static_cast<unsigned_type>(unsigned_type(1) << (sizeof(V) * 8 - 1));
+    }
+    return static_cast<V>(bits);
+}
+template<typename V>
+inline typename std::enable_if<std::is_floating_point<V>::value, V>::type fromOrderKey(uint64_t key)
+{
+    typedef typename std::conditional<sizeof(V) == 4, uint32_t, uint64_t>::type bits_type;
+    bits_type sign = bits_type(1) << (sizeof(V) * 8 - 1);
+    bits_type bits = static_cast<bits_type>(key);
+    bits = (bits & sign) != 0 ? bits ^ sign : ~bits;
+    V value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Bytewise order of two strings, the shorter first on a common prefix.
+inline int compareBytes(const ViewByteBuffer& left, const ViewByteBuffer& right)
+{
+    uint64_t size = left._size < right._size ? left._size : right._size;
+    int order = size > 0 ? memcmp(left._data, right._data, size) : 0;
+    if (order != 0)
+    {
+        return order;
+    }
+    return left._size < right._size ? -1 : (left._size > right._size ? 1 : 0);
+}
+
+// The first eight bytes of a string read big endian, zero padded, so that keys order like prefixes.
+inline uint64_t prefixKey(const ViewByteBuffer& value)
+{
+    uint64_t prefix = 0;
+    if (value._size > 0)
+    {
+        memcpy(&prefix, value._data, value._size < sizeof(prefix) ? value._size : sizeof(prefix));
+    }
+    return __builtin_bswap64(prefix);
+}
+
+// Stable LSD radix sort of keys, with rows moving along unless empty, on their low bytes bytes. Each
+// pass workers count digits over a slice of their own, prefix sums give every worker its offsets per
+// digit, and the slices scatter in parallel. Passes whose digit is the same for every key are skipped.
+inline void radixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& rows, uint64_t bytes, uint32_t workers)
+{
+    uint64_t count = keys.size();
+    bool payload = !rows.empty();
+    workers = workersFor(count / (64 * 1024) + 1, workers);
+    std::vector<uint64_t> keyBuffer(count);
+    std::vector<uint64_t> rowBuffer(payload ? count : 0);
+    std::vector<std::vector<uint64_t>> offsets(workers, std::vector<uint64_t>(256));
+
+    for(uint64_t pass = 0; pass < bytes; ++pass)
+    {
+        uint64_t shift = pass * 8;
+        parallel(workers, [&](uint32_t w) {
+            uint64_t* histogram = offsets[w].data();
+            std::fill(histogram, histogram + 256, 0);
+            const uint64_t* data = keys.data();
+            for(uint64_t i = count * w / workers; i < count * (w + 1) / workers; ++i)
+            {
+                histogram[(data[i] >> shift) & 255]++;
+            }
+        });
+
+        bool trivial = false;
+        uint64_t total = 0;
+        for(uint64_t digit = 0; digit < 256; ++digit)
+        {
+            uint64_t start = total;
+            for(uint32_t w = 0; w < workers; ++w)
+            {
+                uint64_t size = offsets[w][digit];
+                offsets[w][digit] = total;
+                total += size;
+            }
+            trivial |= total - start == count;
+        }
+        if (trivial)
+        {
+            continue;
+        }
+
+        parallel(workers, [&](uint32_t w) {
+            uint64_t* position = offsets[w].data();
+            const uint64_t* data = keys.data();
+            for(uint64_t i = count * w / workers; i < count * (w + 1) / workers; ++i)
+            {
+                uint64_t slot = position[(data[i] >> shift) & 255]++;
+                keyBuffer[slot] = data[i];
+                if (payload)
+                {
+                    rowBuffer[slot] = rows[i];
+                }
+            }
+        });
+        keys.swap(keyBuffer);
+        if (payload)
+        {
+            rows.swap(rowBuffer);
+        }
+    }
+}
+
+// One ORDER BY column read as unsigned keys in the column's order.
+class SortKeys
+{
+public:
+    virtual ~SortKeys() {}
+    virtual uint64_t size() = 0;
+    // Low bytes of the keys that can differ, one radix pass each.
+    virtual uint64_t width() = 0;
+    virtual void read(const uint64_t* rows, uint64_t count, uint64_t* out) = 0;
+    // Validity bits of every row, or nullptr when there are no nulls.
+    virtual const uint64_t* validity()
+    {
+        return nullptr;
+    }
+    // Called once before a sort reads keys.
+    virtual void prepare() {}
+    // False when equal keys can stand for different values; compare() then orders the rows.
+    virtual bool exact()
+    {
+        return true;
+    }
+    virtual int compare(uint64_t left, uint64_t right)
+    {
+        return 0;
+    }
+};
+
+template<typename U, typename C = TypedColumn<PlainStore, U>>
+class ValueSortKeys: public SortKeys
+{
+private:
+    C& _column;
+public:
+    explicit ValueSortKeys(C& column):_column(column) {}
+    uint64_t size() override
+    {
+        return _column.size();
+    }
+    uint64_t width() override
+    {
+        return sizeof(typename U::c_type);
+    }
+    void read(const uint64_t* rows, uint64_t count, uint64_t* out) override
+    {
+        uint64_t perChunk = _column.chunkCount() > 1 ? _column.chunk(0).size : _column.size();
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            out[i] = orderKey(_column.chunk(rows[i] / perChunk).data[rows[i] % perChunk]);
+        }
+    }
+    const uint64_t* validity() override
+    {
+        return validity(_column);
+    }
+private:
+    static const uint64_t* validity(TypedColumn<PlainStore, U>&)
+    {
+        return nullptr;
+    }
+    static const uint64_t* validity(NullableTypedColumn<PlainStore, U>& column)
+    {
+        return column.validity().words();
+    }
+};
+
+// Strings keyed by their first eight bytes read big endian; rows tied on them compare in full.
+template<typename C = TypedColumn<PlainStore, StringType>>
+class StringSortKeys: public SortKeys
+{
+private:
+    C& _column;
+public:
+    explicit StringSortKeys(C& column):_column(column) {}
+    uint64_t size() override
+    {
+        return _column.size();
+    }
+    uint64_t width() override
+    {
+        return sizeof(uint64_t);
+    }
+    void read(const uint64_t* rows, uint64_t count, uint64_t* out) override
+    {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            out[i] = prefixKey(_column.getView(rows[i]));
+        }
+    }
+    const uint64_t* validity() override
+    {
+        return validity(_column);
+    }
+    bool exact() override
+    {
+        return false;
+    }
+    int compare(uint64_t left, uint64_t right) override
+    {
+        return compareBytes(_column.getView(left), _column.getView(right));
+    }
+private:
+    static const uint64_t* validity(TypedColumn<PlainStore, StringType>&)
+    {
+        return nullptr;
+    }
+    static const uint64_t* validity(NullableTypedColumn<PlainStore, StringType>& column)
+    {
+        return column.validity().words();
+    }
+};
+
+// Rank of every code of the dictionary among its values in bytewise order.
+inline std::vector<uint32_t> dictionaryRanks(TypeStore<DictStore>& dictionary)
+{
+    std::vector<uint32_t> codes(dictionary.cardinality());
+    for(uint64_t code = 0; code < codes.size(); ++code)
+    {
+        codes[code] = static_cast<uint32_t>(code);
+    }
+    std::sort(codes.begin(), codes.end(), [&](uint32_t left, uint32_t right) {
+        return compareBytes(dictionary.value(left), dictionary.value(right)) < 0;
+    });
+    std::vector<uint32_t> ranks(codes.size());
+    for(uint64_t rank = 0; rank < codes.size(); ++rank)
+    {
+        ranks[codes[rank]] = static_cast<uint32_t>(rank);
+    }
+    return ranks;
+}
+
+// Dictionary strings keyed by the rank of their code among the sorted dictionary values.
+template<typename C = TypedColumn<DictStore, StringType>>
+class DictSortKeys: public SortKeys
+{
+private:
+    C& _column;
+    std::vector<uint32_t> _ranks;
+public:
+    explicit DictSortKeys(C& column):_column(column) {}
+    uint64_t size() override
+    {
+        return _column.dictionary().size();
+    }
+    uint64_t width() override
+    {
+        uint64_t bytes = 1;
+        while(bytes < sizeof(uint32_t) && (_ranks.size() >> (bytes * 8)) > 0)
+        {
+            bytes++;
+        }
+        return bytes;
+    }
+    void prepare() override
+    {
+        _ranks = dictionaryRanks(_column.dictionary());
+    }
+    void read(const uint64_t* rows, uint64_t count, uint64_t* out) override
+    {
+        TypeStore<DictStore>& dictionary = _column.dictionary();
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            out[i] = _ranks[dictionary.code(rows[i])];
+        }
+    }
+    const uint64_t* validity() override
+    {
+        return validity(_column);
+    }
+private:
+    static const uint64_t* validity(TypedColumn<DictStore, StringType>&)
+    {
+        return nullptr;
+    }
+    static const uint64_t* validity(NullableTypedColumn<DictStore, StringType>& column)
+    {
+        return column.validity().words();
+    }
+};
+
+// ORDER BY one or more columns, each ascending or descending with nulls last. Keys are applied from
+// the last to the first, each a stable radix sort of the permutation so far, so rows tied on the
+// earlier keys keep the order of the later ones. Rows tied on every key keep their input order.
+class OrderBy
+{
+private:
+    uint32_t _workers;
+    std::vector<std::unique_ptr<SortKeys>> _keys;
+    std::vector<SortOrder::type> _orders;
+public:
+    explicit OrderBy(uint32_t workers = std::thread::hardware_concurrency())
+        :_workers(workers > 0 ? workers : 1) {}
+    template<typename U>
+    inline void key(TypedColumn<PlainStore, U>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new ValueSortKeys<U>(column)), order);
+    }
+    template<typename U>
+    inline void key(NullableTypedColumn<PlainStore, U>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new ValueSortKeys<U, NullableTypedColumn<PlainStore, U>>(column)), order);
+    }
+    inline void key(TypedColumn<PlainStore, StringType>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new StringSortKeys<>(column)), order);
+    }
+    inline void key(NullableTypedColumn<PlainStore, StringType>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new StringSortKeys<NullableTypedColumn<PlainStore, StringType>>(column)), order);
+    }
+    inline void key(TypedColumn<DictStore, StringType>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new DictSortKeys<>(column)), order);
+    }
+    inline void key(NullableTypedColumn<DictStore, StringType>& column, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        key(std::unique_ptr<SortKeys>(new DictSortKeys<NullableTypedColumn<DictStore, StringType>>(column)), order);
+    }
+    inline void key(std::unique_ptr<SortKeys> keys, SortOrder::type order = SortOrder::ASCENDING)
+    {
+        _keys.push_back(std::move(keys));
+        _orders.push_back(order);
+    }
+    // The row positions in sorted order.
+    std::vector<uint64_t> run()
+    {
+        if (_keys.empty())
+        {
+            throw std::logic_error("order by needs at least one key column");
+        }
+        uint64_t count = _keys[0]->size();
+        for(uint64_t i = 1; i < _keys.size(); ++i)
+        {
+            if (_keys[i]->size() != count)
+            {
+                throw std::logic_error("key column " + std::to_string(i) + " holds " + std::to_string(_keys[i]->size()) + " rows, not " + std::to_string(count));
+            }
+        }
+        std::vector<uint64_t> rows(count);
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            rows[i] = i;
+        }
+        for(uint64_t k = _keys.size(); k-- > 0;)
+        {
+            apply(*_keys[k], _orders[k], rows);
+        }
+        return rows;
+    }
+private:
+    inline void apply(SortKeys& keys, SortOrder::type order, std::vector<uint64_t>& rows)
+    {
+        keys.prepare();
+        std::vector<uint64_t> nulls;
+        const uint64_t* validity = keys.validity();
+        if (validity != nullptr)
+        {
+            uint64_t kept = 0;
+            for(uint64_t row : rows)
+            {
+                if (((validity[row / 64] >> (row % 64)) & 1) != 0)
+                {
+                    rows[kept++] = row;
+                }
+                else
+                {
+                    nulls.push_back(row);
+                }
+            }
+            rows.resize(kept);
+        }
+
+        uint64_t count = rows.size();
+        uint64_t width = keys.width();
+        uint64_t mask = width >= sizeof(uint64_t) ? ~uint64_t(0) : (uint64_t(1) << (width * 8)) - 1;
+        bool descending = order == SortOrder::DESCENDING;
+        std::vector<uint64_t> values(count);
+        uint32_t workers = workersFor(count / (64 * 1024) + 1, _workers);
+        parallel(workers, [&](uint32_t w) {
+            uint64_t begin = count * w / workers;
+            uint64_t end = count * (w + 1) / workers;
+            keys.read(rows.data() + begin, end - begin, values.data() + begin);
+            if (descending)
+            {
+                for(uint64_t i = begin; i < end; ++i)
+                {
+                    values[i] = ~values[i] & mask;
+                }
+            }
+        });
+        radixSort(values, rows, width, _workers);
+        if (!keys.exact())
+        {
+            ties(keys, descending, values, rows, workers);
+        }
+        rows.insert(rows.end(), nulls.begin(), nulls.end());
+    }
+    // Sorts every run of equal keys with compare(); a worker takes the runs starting in its slice.
+    inline void ties(SortKeys& keys, bool descending, const std::vector<uint64_t>& values, std::vector<uint64_t>& rows, uint32_t workers)
+    {
+        uint64_t count = values.size();
+        parallel(workers, [&](uint32_t w) {
+            uint64_t begin = count * w / workers;
+            uint64_t end = count * (w + 1) / workers;
+            while(begin > 0 && begin < end && values[begin] == values[begin - 1])
+            {
+                begin++;
+            }
+            for(uint64_t first = begin; first < end;)
+            {
+                uint64_t last = first + 1;
+                while(last < count && values[last] == values[first])
+                {
+                    last++;
+                }
+                auto less = [&](uint64_t left, uint64_t right) {
+                    return descending ? keys.compare(right, left) < 0 : keys.compare(left, right) < 0;
+                };
+                // Runs are mostly one repeated value, already in order.
+                if (last - first > 1 && !std::is_sorted(rows.begin() + first, rows.begin() + last, less))
+                {
+                    std::stable_sort(rows.begin() + first, rows.begin() + last, less);
+                }
+                first = last;
+            }
+        });
+    }
+};
+
+template<typename C>
+inline std::vector<uint64_t> argsort(C& column, SortOrder::type order = SortOrder::ASCENDING, uint32_t workers = std::thread::hardware_concurrency())
+{
+    OrderBy orderBy(workers);
+    orderBy.key(column, order);
+    return orderBy.run();
+}
+
+// Appends the values of a plain numeric column to target in sorted order, radix sorting the values
+// alone.
+template<typename U>
+inline void sort(TypedColumn<PlainStore, U>& column, TypedColumn<PlainStore, U>& target, SortOrder::type order = SortOrder::ASCENDING,
+                 uint32_t workers = std::thread::hardware_concurrency())
+{
+    typedef typename U::c_type c_type;
+
+    uint64_t count = column.size();
+    uint64_t mask = sizeof(c_type) >= sizeof(uint64_t) ? ~uint64_t(0) : (uint64_t(1) << (sizeof(c_type) * 8)) - 1;
+    std::vector<uint64_t> keys(count);
+    for(uint64_t index = 0; index < column.chunkCount(); ++index)
+    {
+        ColumnChunk<U> chunk = column.chunk(index);
+        for(uint64_t i = 0; i < chunk.size; ++i)
+        {
+            uint64_t key = orderKey(chunk.data[i]);
+            keys[chunk.offset + i] = order == SortOrder::DESCENDING ? ~key & mask : key;
+        }
+    }
+    std::vector<uint64_t> rows;
+    radixSort(keys, rows, sizeof(c_type), workers > 0 ? workers : 1);
+
+    std::vector<c_type> values(count);
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        values[i] = fromOrderKey<c_type>(order == SortOrder::DESCENDING ? ~keys[i] & mask : keys[i]);
+    }
+    target.putBatch(reinterpret_cast<const char*>(values.data()), count);
+}
+
+// Appends the values of any other column to target in sorted order, gathered through argsort().
+template<typename C>
+inline void sort(C& column, Column& target, SortOrder::type order = SortOrder::ASCENDING, uint32_t workers = std::thread::hardware_concurrency())
+{
+    std::vector<uint64_t> rows = argsort(column, order, workers);
+    gather(column, rows.data(), rows.size(), target);
+}
+
+#endif // SORT_H
@@ -0,0 +1,400 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "column.h"
+#include "adaptive.h"
+#include "operators.h"
+
+struct Field
+{
+    std::string name;
+    Type::type type;
+    Encoding::type encoding;
+    bool nullable;
+};
+
+class Schema
+{
+private:
+    std::vector<Field> _fields;
+public:
+    Schema() {}
+    Schema(std::initializer_list<Field> fields)
+    {
+        for(const Field& field : fields)
+        {
+            add(field);
+        }
+    }
+    inline void add(const Field& field)
+    {
+        for(const Field& other : _fields)
+        {
+            if (other.name == field.name)
+            {
+                throw std::invalid_argument("duplicate column " + field.name);
+            }
+        }
+        _fields.push_back(field);
+    }
+    inline uint64_t size() const
+    {
+        return _fields.size();
+    }
+    inline const Field& field(uint64_t index) const
+    {
+        return _fields.at(index);
+    }
+    inline uint64_t index(const std::string& name) const
+    {
+        for(uint64_t i = 0; i < _fields.size(); ++i)
+        {
+            if (_fields[i].name == name)
+            {
+                return i;
+            }
+        }
+        throw std::out_of_range("no column " + name);
+    }
+};
+
+// Rows [offset, offset + size) of one column. Fixed width values sit in values, strings in views;
+// validity holds one bit per row of the batch, or is nullptr when the column has no nulls.
+struct ColumnVector
+{
+    Type::type type;
+    const char* values;
+    const ViewByteBuffer* views;
+    const uint64_t* validity;
+
+    template<typename T>
+    inline const typename T::c_type* data() const
+    {
+        return reinterpret_cast<const typename T::c_type*>(values);
+    }
+    inline bool isNull(uint64_t row) const
+    {
+        return validity != nullptr && ((validity[row / 64] >> (row % 64)) & 1) == 0;
+    }
+};
+
+struct Batch
+{
+    uint64_t offset;
+    uint64_t size;
+    std::vector<ColumnVector> columns;
+};
+
+// Fills one column's vector of a batch.
+class VectorReader
+{
+public:
+    virtual ~VectorReader() {}
+    virtual void read(uint64_t begin, uint64_t count, ColumnVector& out) = 0;
+};
+
+// Plain fixed width values straight from the column's chunks, copied only across a chunk boundary.
+template<typename U, typename C = TypedColumn<PlainStore, U>>
+class PlainVectorReader: public VectorReader
+{
+private:
+    typedef typename U::c_type c_type;
+
+    C& _column;
+    std::vector<c_type> _buffer;
+public:
+    PlainVectorReader(C& column, uint64_t batchSize):_column(column), _buffer(batchSize) {}
+    void read(uint64_t begin, uint64_t count, ColumnVector& out) override
+    {
+        out.values = reinterpret_cast<const char*>(plainRows<U>(_column, begin, count, _buffer.data()));
+        out.views = nullptr;
+        out.validity = validity(_column, begin);
+    }
+private:
+    static const uint64_t* validity(TypedColumn<PlainStore, U>&, uint64_t)
+    {
+        return nullptr;
+    }
+    static const uint64_t* validity(NullableTypedColumn<PlainStore, U>& column, uint64_t begin)
+    {
+        return column.validity().words() + begin / 64;
+    }
+};
+
+// Any column through getView(), value by value. Strings are copied into a buffer of the reader unless
+// they sit in a dictionary, as views of compressed pages do not outlive the next few getView() calls.
+class ViewVectorReader: public VectorReader
+{
+private:
+    Column& _column;
+    IsNullable* _nulls;
+    uint64_t _width;
+    bool _copy;
+    std::vector<char> _values;
+    std::vector<ViewByteBuffer> _views;
+    std::vector<char> _strings;
+    std::vector<uint64_t> _validity;
+public:
+    ViewVectorReader(Column& column, const Field& field, uint64_t batchSize)
+        :_column(column), _nulls(field.nullable ? dynamic_cast<IsNullable*>(&column) : nullptr), _width(valueWidth(field.type)),
+          _copy(_width == 0 && dynamic_cast<TypedColumn<DictStore, StringType>*>(&column) == nullptr
+                && dynamic_cast<NullableTypedColumn<DictStore, StringType>*>(&column) == nullptr),
+          _values(batchSize * _width), _views(_width == 0 ? batchSize : 0, ViewByteBuffer(0, nullptr)), _validity((batchSize + 63) / 64) {}
+    void read(uint64_t begin, uint64_t count, ColumnVector& out) override
+    {
+        if (_nulls != nullptr)
+        {
+            std::fill(_validity.begin(), _validity.end(), 0);
+        }
+        uint64_t buffer;
+        _strings.clear();
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            if (_nulls != nullptr && _nulls->getNull(begin + i))
+            {
+                if (_width > 0)
+                {
+                    memset(&_values[i * _width], 0, _width);
+                }
+                else
+                {
+                    _views[i] = ViewByteBuffer(0, nullptr);
+                }
+                continue;
+            }
+            if (_nulls != nullptr)
+            {
+                _validity[i / 64] |= uint64_t(1) << (i % 64);
+            }
+            if (_width > 0)
+            {
+                ViewByteBuffer value = _column.decodeView(begin + i, reinterpret_cast<char*>(&buffer));
+                memcpy(&_values[i * _width], value._data, _width);
+            }
+            else if (_copy)
+            {
+                ViewByteBuffer value = _column.getView(begin + i);
+                _strings.insert(_strings.end(), value._data, value._data + value._size);
+                _views[i] = ViewByteBuffer(value._size, nullptr);
+            }
+            else
+            {
+                _views[i] = _column.getView(begin + i);
+            }
+        }
+        // Point the views into the buffer only once it has stopped growing.
+        char* data = _strings.data();
+        for(uint64_t i = 0; _copy && i < count; ++i)
+        {
+            _views[i]._data = _views[i]._size > 0 ? data : nullptr;
+            data += _views[i]._size;
+        }
+        out.values = _width > 0 ? _values.data() : nullptr;
+        out.views = _width > 0 ? nullptr : _views.data();
+        out.validity = _nulls != nullptr ? _validity.data() : nullptr;
+    }
+};
+
+template<typename U>
+inline std::unique_ptr<VectorReader> makeVectorReader(Column& column, const Field& field, uint64_t batchSize)
+{
+    if (TypedColumn<PlainStore, U>* plain = dynamic_cast<TypedColumn<PlainStore, U>*>(&column))
+    {
+        return std::unique_ptr<VectorReader>(new PlainVectorReader<U>(*plain, batchSize));
+    }
+    if (NullableTypedColumn<PlainStore, U>* nullable = dynamic_cast<NullableTypedColumn<PlainStore, U>*>(&column))
+    {
+        return std::unique_ptr<VectorReader>(new PlainVectorReader<U, NullableTypedColumn<PlainStore, U>>(*nullable, batchSize));
+    }
+    return std::unique_ptr<VectorReader>(new ViewVectorReader(column, field, batchSize));
+}
+
+inline std::unique_ptr<VectorReader> makeVectorReader(Column& column, const Field& field, uint64_t batchSize)
+{
+    switch(field.type)
+    {
+    case Type::UINT8: return makeVectorReader<UInt8Type>(column, field, batchSize);
+    case Type::INT8: return makeVectorReader<Int8Type>(column, field, batchSize);
+    case Type::UINT16: return makeVectorReader<UInt16Type>(column, field, batchSize);
+    case Type::INT16: return makeVectorReader<Int16Type>(column, field, batchSize);
+    case Type::UINT32: return makeVectorReader<UInt32Type>(column, field, batchSize);
+    case Type::INT32: return makeVectorReader<Int32Type>(column, field, batchSize);
+    case Type::UINT64: return makeVectorReader<UInt64Type>(column, field, batchSize);
+    case Type::INT64: return makeVectorReader<Int64Type>(column, field, batchSize);
+    case Type::FLOAT: return makeVectorReader<FloatType>(column, field, batchSize);
+    case Type::DOUBLE: return makeVectorReader<DoubleType>(column, field, batchSize);
+    case Type::STRING: return std::unique_ptr<VectorReader>(new ViewVectorReader(column, field, batchSize));
+    }
+    throw std::invalid_argument("unknown type " + std::to_string(field.type));
+}
+
+// Walks a table batch by batch over a projection of its columns. A batch stays valid until the
+// next call to next().
+class TableScanner
+{
+private:
+    std::vector<Type::type> _types;
+    std::vector<std::unique_ptr<VectorReader>> _readers;
+    uint64_t _rows;
+    uint64_t _batchSize;
+    uint64_t _next = 0;
+public:
+    TableScanner(std::vector<Type::type> types, std::vector<std::unique_ptr<VectorReader>> readers, uint64_t rows, uint64_t batchSize)
+        :_types(std::move(types)), _readers(std::move(readers)), _rows(rows), _batchSize(batchSize) {}
+    inline bool next(Batch& batch)
+    {
+        if (_next >= _rows)
+        {
+            return false;
+        }
+        batch.offset = _next;
+        batch.size = _rows - _next < _batchSize ? _rows - _next : _batchSize;
+        batch.columns.resize(_readers.size());
+        for(uint64_t c = 0; c < _readers.size(); ++c)
+        {
+            batch.columns[c].type = _types[c];
+            _readers[c]->read(batch.offset, batch.size, batch.columns[c]);
+        }
+        _next += batch.size;
+        return true;
+    }
+    inline void reset()
+    {
+        _next = 0;
+    }
+};
+
+// Columns of equal length under a schema. Columns come from makeColumn(), or are AdaptiveColumns for
+// Encoding::ADAPTIVE.
+class Table
+{
+public:
+    static constexpr uint64_t default_batch_size = 2048;
+private:
+    Schema _schema;
+    Allocator* _allocator;
+    std::vector<std::unique_ptr<Column>> _columns;
+public:
+    explicit Table(const Schema& schema = Schema(), Allocator* allocator = nullptr):_allocator(allocator)
+    {
+        for(uint64_t i = 0; i < schema.size(); ++i)
+        {
+            add(schema.field(i));
+        }
+    }
+    inline void add(const Field& field)
+    {
+        if (size() > 0)
+        {
+            throw std::logic_error("column " + field.name + " added to a table holding rows");
+        }
+        _schema.add(field);
+        if (field.encoding == Encoding::ADAPTIVE)
+        {
+            _columns.emplace_back(new AdaptiveColumn(field.type, field.nullable, AdaptiveColumn::default_group_size,
+                                                     AdaptiveColumn::default_sample_size, _allocator));
+        }
+        else
+        {
+            _columns.push_back(makeColumn(field.type, field.encoding, field.nullable, _allocator));
+        }
+    }
+    inline const Schema& schema() const
+    {
+        return _schema;
+    }
+    inline uint64_t columnCount() const
+    {
+        return _columns.size();
+    }
+    inline Column& column(uint64_t index)
+    {
+        return *_columns.at(index);
+    }
+    inline Column& column(const std::string& name)
+    {
+        return *_columns[_schema.index(name)];
+    }
+    // The columns in schema order, e.g. for CsvIngest; they must keep their number and types.
+    inline std::vector<std::unique_ptr<Column>>& columns()
+    {
+        return _columns;
+    }
+    inline uint64_t size()
+    {
+        return _columns.empty() ? 0 : _columns[0]->size();
+    }
+    // Parsers from text for every column, in schema order.
+    inline std::vector<std::shared_ptr<UnaryOperator>> casters() const
+    {
+        std::vector<std::shared_ptr<UnaryOperator>> casters;
+        for(uint64_t i = 0; i < _schema.size(); ++i)
+        {
+            casters.push_back(makeFromStringCast(_schema.field(i).type));
+        }
+        return casters;
+    }
+    // Encodes rows adaptive columns still hold back for sampling.
+    inline void flush()
+    {
+        for(auto& column : _columns)
+        {
+            if (AdaptiveColumn* adaptive = dynamic_cast<AdaptiveColumn*>(column.get()))
+            {
+                adaptive->flush();
+            }
+        }
+    }
+    inline uint64_t memoryUsage()
+    {
+        uint64_t bytes = 0;
+        for(auto& column : _columns)
+        {
+            bytes += column->memoryUsage();
+        }
+        return bytes;
+    }
+    // Batches of batchSize rows, a multiple of 64, over the named columns or all of them.
+    inline TableScanner scan(uint64_t batchSize = default_batch_size, const std::vector<std::string>& names = std::vector<std::string>())
+    {
+        if (batchSize == 0 || batchSize % 64 != 0)
+        {
+            throw std::invalid_argument("batch size must be a positive multiple of 64");
+        }
+        uint64_t rows = size();
+        std::vector<uint64_t> projection;
+        for(const std::string& name : names)
+        {
+            projection.push_back(_schema.index(name));
+        }
+        if (names.empty())
+        {
+            for(uint64_t i = 0; i < _columns.size(); ++i)
+            {
+                projection.push_back(i);
+            }
+        }
+
+        std::vector<Type::type> types;
+        std::vector<std::unique_ptr<VectorReader>> readers;
+        for(uint64_t index : projection)
+        {
+            const Field& field = _schema.field(index);
+            if (_columns[index]->size() != rows)
+            {
+                throw std::logic_error("column " + field.name + " holds " + std::to_string(_columns[index]->size()) + " rows, not " + std::to_string(rows));
+            }
+            types.push_back(field.type);
+            readers.push_back(makeVectorReader(*_columns[index], field, batchSize));
+        }
+        return TableScanner(std::move(types), std::move(readers), rows, batchSize);
+    }
+};
+
+#endif // TABLE_H
@@ -0,0 +1,631 @@
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <functional>
+#include <map>
+#include <cmath>
+#include <unistd.h>
+
+#include "column.h"
+#include "adaptive.h"
+#include "compress.h"
+#include "columnfile.h"
+#include "groupby.h"
+#include "join.h"
+#include "sort.h"
+#include "topk.h"
+
+using namespace std;
+
+// Each check compares an operator against a brute-force reference on random data.
+
+static uint64_t failures = 0;
+
+static void expect(bool condition, const string& what)
+{
+    if (!condition)
+    {
+        cerr << "FAIL " << what << endl;
+        failures++;
+    }
+}
+
+template<typename V>
+static void putValue(Column& column, V value)
+{
+    ViewByteBuffer view(sizeof(value), reinterpret_cast<char*>(&value));
+    column.put(view);
+}
+
+static void putString(Column& column, const string& value)
+{
+    ViewByteBuffer view(value.size(), value.data());
+    column.put(view);
+}
+
+static string viewString(const ViewByteBuffer& value)
+{
+    return string(value._data, value._size);
+}
+
+static string name(uint64_t index)
+{
+    return "name_" + to_string(index);
+}
+
+typedef vector<pair<uint64_t, uint64_t>> Pairs;
+
+static const string null_key = string(1, '\0');
+
+static Pairs pairs(const JoinResult& result)
+{
+    Pairs out;
+    for(uint64_t i = 0; i < result.size(); ++i)
+    {
+        out.emplace_back(result.left[i], result.right[i]);
+    }
+    sort(out.begin(), out.end());
+    return out;
+}
+
+// Every pair of rows equal on all keys of columns, neither null; LEFT adds unmatched left rows.
+static Pairs nestedLoop(const vector<vector<string>>& left, const vector<vector<string>>& right, const vector<uint64_t>& columns, JoinType::type type)
+{
+    Pairs out;
+    for(uint64_t l = 0; l < left.size(); ++l)
+    {
+        bool matched = false;
+        for(uint64_t r = 0; r < right.size(); ++r)
+        {
+            bool equal = true;
+            for(uint64_t k : columns)
+            {
+                equal = equal && left[l][k] != null_key && left[l][k] == right[r][k];
+            }
+            if (equal)
+            {
+                out.emplace_back(l, r);
+                matched = true;
+            }
+        }
+        if (!matched && type == JoinType::LEFT)
+        {
+            out.emplace_back(l, JoinResult::none);
+        }
+    }
+    sort(out.begin(), out.end());
+    return out;
+}
+
+static void testJoin(mt19937_64& random)
+{
+    NullableTypedColumn<PlainStore, Int64Type> leftIds;
+    TypedColumn<DictStore, StringType> leftNames;
+    TypedColumn<PlainStore, Int64Type> rightIds;
+    NullableTypedColumn<DictStore, StringType> rightNames;
+    vector<vector<string>> left(3000);
+    vector<vector<string>> right(2000);
+
+    for(vector<string>& row : left)
+    {
+        int64_t id = static_cast<int64_t>(random() % 400) - 100;
+        string text = name(random() % 50);
+        if (random() % 10 == 0)
+        {
+            leftIds.putNull();
+            row.push_back(null_key);
+        }
+        else
+        {
+            putValue(leftIds, id);
+            row.push_back(to_string(id));
+        }
+        putString(leftNames, text);
+        row.push_back(text);
+    }
+    for(vector<string>& row : right)
+    {
+        int64_t id = static_cast<int64_t>(random() % 500) - 100;
+        string text = name(random() % 60);
+        putValue(rightIds, id);
+        row.push_back(to_string(id));
+        if (random() % 10 == 0)
+        {
+            rightNames.putNull();
+            row.push_back(null_key + "right");
+        }
+        else
+        {
+            putString(rightNames, text);
+            row.push_back(text);
+        }
+    }
+
+    for(JoinType::type type : {JoinType::INNER, JoinType::LEFT})
+    {
+        for(uint32_t workers : {1u, 4u})
+        {
+            string what = string(type == JoinType::INNER ? "inner" : "left") + " join, " + to_string(workers) + " workers, ";
+
+            HashJoin ids(type, workers);
+            ids.left().key(leftIds);
+            ids.right().key(rightIds);
+            expect(pairs(ids.run()) == nestedLoop(left, right, {0}, type), what + "INT64 key");
+
+            HashJoin names(type, workers);
+            names.left().key(leftNames);
+            names.right().key(rightNames);
+            expect(pairs(names.run()) == nestedLoop(left, right, {1}, type), what + "dictionary key");
+
+            HashJoin both(type, workers);
+            both.left().key(leftIds);
+            both.left().key(leftNames);
+            both.right().key(rightIds);
+            both.right().key(rightNames);
+            expect(pairs(both.run()) == nestedLoop(left, right, {0, 1}, type), what + "INT64 and dictionary keys");
+        }
+    }
+}
+
+// Orders two rows on one key as OrderBy does: nulls last, then by value in the given order.
+template<typename V>
+static function<int(uint64_t, uint64_t)> orderOf(const vector<V>& values, const vector<char>& nulls, SortOrder::type order)
+{
+    return [&values, &nulls, order](uint64_t x, uint64_t y) {
+        if (nulls[x] != nulls[y])
+        {
+            return nulls[x] != 0 ? 1 : -1;
+        }
+        if (nulls[x] != 0 || values[x] == values[y])
+        {
+            return 0;
+        }
+        return (values[x] < values[y]) == (order == SortOrder::ASCENDING) ? -1 : 1;
+    };
+}
+
+static vector<uint64_t> sortReference(uint64_t rows, const vector<function<int(uint64_t, uint64_t)>>& keys)
+{
+    vector<uint64_t> order(rows);
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](uint64_t x, uint64_t y) {
+        for(auto& key : keys)
+        {
+            int compared = key(x, y);
+            if (compared != 0)
+            {
+                return compared < 0;
+            }
+        }
+        return false;
+    });
+    return order;
+}
+
+static void testSort(mt19937_64& random)
+{
+    const uint64_t rows = 20000;
+    NullableTypedColumn<PlainStore, Int32Type> numbers;
+    TypedColumn<DictStore, StringType> names;
+    TypedColumn<PlainStore, DoubleType> reals;
+    TypedColumn<PlainStore, StringType> texts;
+    vector<int32_t> numberValues(rows);
+    vector<string> nameValues(rows);
+    vector<double> realValues(rows);
+    vector<string> textValues(rows);
+    vector<char> numberNulls(rows, 0);
+    vector<char> noNulls(rows, 0);
+
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        numberValues[i] = static_cast<int32_t>(random() % 100) - 50;
+        numberNulls[i] = random() % 20 == 0;
+        if (numberNulls[i] != 0)
+        {
+            numbers.putNull();
+        }
+        else
+        {
+            putValue(numbers, numberValues[i]);
+        }
+        nameValues[i] = name(random() % 30);
+        putString(names, nameValues[i]);
+        realValues[i] = static_cast<double>(static_cast<int64_t>(random() % 2000001) - 1000000) / 7;
+        putValue(reals, realValues[i]);
+        // Shared prefixes longer than eight bytes leave ties to the full comparison.
+        textValues[i] = "long_prefix_" + to_string(random() % 500);
+        putString(texts, textValues[i]);
+    }
+
+    for(uint32_t workers : {1u, 4u})
+    {
+        string what = "order by, " + to_string(workers) + " workers, ";
+
+        OrderBy numberName(workers);
+        numberName.key(numbers, SortOrder::ASCENDING);
+        numberName.key(names, SortOrder::DESCENDING);
+        expect(numberName.run() == sortReference(rows, {orderOf(numberValues, numberNulls, SortOrder::ASCENDING),
+                                                         orderOf(nameValues, noNulls, SortOrder::DESCENDING)}), what + "INT32 asc, dictionary desc");
+
+        OrderBy real(workers);
+        real.key(reals, SortOrder::DESCENDING);
+        expect(real.run() == sortReference(rows, {orderOf(realValues, noNulls, SortOrder::DESCENDING)}), what + "DOUBLE desc");
+
+        OrderBy textNumber(workers);
+        textNumber.key(texts, SortOrder::ASCENDING);
+        textNumber.key(numbers, SortOrder::DESCENDING);
+        expect(textNumber.run() == sortReference(rows, {orderOf(textValues, noNulls, SortOrder::ASCENDING),
+                                                         orderOf(numberValues, numberNulls, SortOrder::DESCENDING)}), what + "STRING asc, INT32 desc");
+    }
+}
+
+// The k best rows not skipped, ties to the lower row.
+template<typename V>
+static vector<uint64_t> topReference(const vector<V>& values, const vector<char>& skip, uint64_t k, SortOrder::type order)
+{
+    vector<uint64_t> rows;
+    for(uint64_t i = 0; i < values.size(); ++i)
+    {
+        if (skip[i] == 0)
+        {
+            rows.push_back(i);
+        }
+    }
+    stable_sort(rows.begin(), rows.end(), [&](uint64_t x, uint64_t y) {
+        return order == SortOrder::ASCENDING ? values[x] < values[y] : values[x] > values[y];
+    });
+    rows.resize(rows.size() < k ? rows.size() : k);
+    return rows;
+}
+
+static void testTopK(mt19937_64& random)
+{
+    const uint64_t rows = 20000;
+    NullableTypedColumn<PlainStore, Int64Type> numbers;
+    TypedColumn<PlainStore, DoubleType> reals;
+    TypedColumn<DictStore, StringType> names;
+    TypedColumn<PlainStore, StringType> texts;
+    vector<int64_t> numberValues(rows);
+    vector<double> realValues(rows);
+    vector<string> nameValues(rows);
+    vector<string> textValues(rows);
+    vector<char> numberNulls(rows, 0);
+    vector<char> realNaNs(rows, 0);
+    vector<char> noNulls(rows, 0);
+    Bitmap selection(rows);
+    vector<char> unselected(rows, 0);
+
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        numberValues[i] = static_cast<int64_t>(random() % 1000) - 500;
+        numberNulls[i] = random() % 10 == 0;
+        if (numberNulls[i] != 0)
+        {
+            numbers.putNull();
+        }
+        else
+        {
+            putValue(numbers, numberValues[i]);
+        }
+        realNaNs[i] = random() % 50 == 0;
+        realValues[i] = realNaNs[i] != 0 ? NAN : static_cast<double>(random() % 100000) / 3;
+        putValue(reals, realValues[i]);
+        nameValues[i] = name(random() % 300);
+        putString(names, nameValues[i]);
+        textValues[i] = "long_prefix_" + to_string(random() % 3000);
+        putString(texts, textValues[i]);
+        bool selected = random() % 10 < 7;
+        selection.set(i, selected);
+        unselected[i] = !selected;
+    }
+    vector<char> numberSkipped(rows);
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        numberSkipped[i] = numberNulls[i] != 0 || unselected[i] != 0;
+    }
+
+    for(SortOrder::type order : {SortOrder::ASCENDING, SortOrder::DESCENDING})
+    {
+        for(uint64_t k : {uint64_t(0), uint64_t(1), uint64_t(37), uint64_t(5000), rows + 10})
+        {
+            for(uint32_t workers : {1u, 4u})
+            {
+                string what = "top " + to_string(k) + (order == SortOrder::ASCENDING ? " asc, " : " desc, ") + to_string(workers) + " workers, ";
+                expect(topK(numbers, k, order, &selection, workers) == topReference(numberValues, numberSkipped, k, order), what + "nullable INT64 with selection");
+                expect(topK(reals, k, order, nullptr, workers) == topReference(realValues, realNaNs, k, order), what + "DOUBLE with NaNs");
+                expect(topK(names, k, order, nullptr, workers) == topReference(nameValues, noNulls, k, order), what + "dictionary STRING");
+                expect(topK(texts, k, order, nullptr, workers) == topReference(textValues, noNulls, k, order), what + "plain STRING");
+            }
+        }
+    }
+}
+
+struct GroupReference
+{
+    uint64_t rows = 0;
+    vector<Aggregate<Int64Type>> aggregates;
+};
+
+static void testGroupBy(mt19937_64& random)
+{
+    const uint64_t rows = 30000;
+    TypedColumn<PlainStore, Int32Type> numbers;
+    TypedColumn<DictStore, StringType> names;
+    NullableTypedColumn<PlainStore, Int64Type> values;
+    TypedColumn<PlainStore, Int64Type> counts;
+    vector<int32_t> numberValues(rows);
+    vector<string> nameValues(rows);
+    vector<int64_t> valueValues(rows);
+    vector<char> valueNulls(rows);
+    vector<int64_t> countValues(rows);
+
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        numberValues[i] = static_cast<int32_t>(random() % 40) - 20;
+        putValue(numbers, numberValues[i]);
+        nameValues[i] = name(random() % 25);
+        putString(names, nameValues[i]);
+        valueValues[i] = static_cast<int64_t>(random() % 2000001) - 1000000;
+        valueNulls[i] = random() % 10 == 0;
+        if (valueNulls[i] != 0)
+        {
+            values.putNull();
+        }
+        else
+        {
+            putValue(values, valueValues[i]);
+        }
+        countValues[i] = static_cast<int64_t>(random() % 100);
+        putValue(counts, countValues[i]);
+    }
+
+    // Groups by the number column, the name column or both.
+    auto check = [&](bool byNumber, bool byName, uint32_t workers) {
+        map<string, GroupReference> reference;
+        for(uint64_t i = 0; i < rows; ++i)
+        {
+            string key = (byNumber ? to_string(numberValues[i]) : "") + "|" + (byName ? nameValues[i] : "");
+            GroupReference& group = reference[key];
+            group.aggregates.resize(2);
+            group.rows++;
+            int64_t row[2] = {valueValues[i], countValues[i]};
+            for(uint64_t v = 0; v < 2; ++v)
+            {
+                if (v == 0 && valueNulls[i] != 0)
+                {
+                    continue;
+                }
+                Aggregate<Int64Type>& aggregate = group.aggregates[v];
+                aggregate.count++;
+                aggregate.sum += row[v];
+                aggregate.min = row[v] < aggregate.min ? row[v] : aggregate.min;
+                aggregate.max = row[v] > aggregate.max ? row[v] : aggregate.max;
+            }
+        }
+
+        HashGroupBy<Int64Type> groupBy(workers);
+        if (byNumber)
+        {
+            groupBy.key(numbers);
+        }
+        if (byName)
+        {
+            groupBy.key(names);
+        }
+        groupBy.value(values);
+        groupBy.value(counts);
+        GroupByResult<Int64Type> result = groupBy.run();
+
+        string what = "group by" + string(byNumber ? " INT32" : "") + (byName ? " dictionary" : "") + ", " + to_string(workers) + " workers";
+        bool same = result.groupCount() == reference.size();
+        for(uint64_t g = 0; same && g < result.groupCount(); ++g)
+        {
+            string key = "|";
+            uint64_t column = 0;
+            if (byNumber)
+            {
+                uint64_t word = result.key(g, column++);
+                int32_t number;
+                memcpy(&number, &word, sizeof(number));
+                key = to_string(number) + key;
+            }
+            if (byName)
+            {
+                key += viewString(names.dictionary().value(static_cast<uint32_t>(result.key(g, column++))));
+            }
+            auto found = reference.find(key);
+            same = found != reference.end() && found->second.rows == result.rows[g];
+            for(uint64_t v = 0; same && v < 2; ++v)
+            {
+                const Aggregate<Int64Type>& expected = found->second.aggregates[v];
+                const Aggregate<Int64Type>& actual = result.aggregate(g, v);
+                same = expected.count == actual.count && expected.sum == actual.sum && expected.min == actual.min && expected.max == actual.max;
+            }
+            if (same)
+            {
+                // Each group comes out once.
+                reference.erase(found);
+            }
+        }
+        expect(same, what);
+    };
+
+    for(uint32_t workers : {1u, 4u})
+    {
+        check(false, true, workers);
+        check(true, false, workers);
+        check(true, true, workers);
+    }
+}
+
+static void testLz4(mt19937_64& random)
+{
+    vector<pair<string, string>> inputs;
+    inputs.emplace_back("empty", "");
+    inputs.emplace_back("one byte", "a");
+    inputs.emplace_back("13 bytes", "abcdabcdabcda");
+    inputs.emplace_back("zeros", string(100000, '\0'));
+
+    string noise(200000, '\0');
+    for(char& c : noise)
+    {
+        c = static_cast<char>(random());
+    }
+    inputs.emplace_back("random bytes", noise);
+
+    string words;
+    while(words.size() < 1024 * 1024)
+    {
+        words += name(random() % 200) + " ";
+    }
+    inputs.emplace_back("words", words);
+
+    // Matches at the largest offset LZ4 can encode and just past it.
+    string far = noise.substr(0, 70000);
+    far += far.substr(0, 70000);
+    inputs.emplace_back("far matches", far);
+
+    for(Codec::type codec : {Codec::NONE, Codec::LZ4, Codec::ZSTD})
+    {
+        if (!codecAvailable(codec))
+        {
+            continue;
+        }
+        for(auto& input : inputs)
+        {
+            string what = "codec " + to_string(codec) + " round trip of " + input.first;
+            const string& raw = input.second;
+            vector<char> packed(compressBound(codec, raw.size()) + 1);
+            uint64_t size = compress(codec, raw.data(), raw.size(), packed.data());
+            vector<char> unpacked(raw.size() + 1);
+            decompress(codec, packed.data(), size, unpacked.data(), raw.size());
+            expect(size <= compressBound(codec, raw.size()) && string(unpacked.data(), raw.size()) == raw, what);
+            if (codec != Codec::NONE && (input.first == "zeros" || input.first == "words"))
+            {
+                expect(size < raw.size() / 2, what + " compresses");
+            }
+        }
+    }
+
+    // A truncated block must be rejected rather than read past its end.
+    vector<char> packed(compressBound(Codec::LZ4, words.size()));
+    uint64_t size = compress(Codec::LZ4, words.data(), words.size(), packed.data());
+    vector<char> unpacked(words.size());
+    bool rejected = false;
+    try {
+        decompress(Codec::LZ4, packed.data(), size / 2, unpacked.data(), words.size());
+    } catch(runtime_error&)
+    {
+        rejected = true;
+    }
+    expect(rejected, "truncated lz4 block");
+}
+
+static void fill(Column& column, Type::type type, bool nullable, uint64_t rows, mt19937_64& random)
+{
+    IsNullable* nulls = dynamic_cast<IsNullable*>(&column);
+    for(uint64_t i = 0; i < rows; ++i)
+    {
+        if (nullable && random() % 10 == 0)
+        {
+            nulls->putNull();
+            continue;
+        }
+        // Runs and a slow trend keep every encoding on its compact path for part of the rows.
+        int64_t value = i < rows / 2 ? static_cast<int64_t>(i / 100) : static_cast<int64_t>(i * 3 + random() % 5);
+        switch(type)
+        {
+        case Type::INT32: putValue(column, static_cast<int32_t>(value)); break;
+        case Type::INT64: putValue(column, value); break;
+        case Type::DOUBLE: putValue(column, static_cast<double>(value) / 4); break;
+        default: putString(column, name(static_cast<uint64_t>(value) % 1000) + string(random() % 40, 'x')); break;
+        }
+    }
+}
+
+static string readFile(const string& path)
+{
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void testColumnFile(mt19937_64& random)
+{
+    const uint64_t rows = 20000;
+    vector<unique_ptr<Column>> columns;
+    vector<string> names;
+    for(Type::type type : {Type::INT32, Type::INT64, Type::DOUBLE, Type::STRING})
+    {
+        for(int encoding = Encoding::PLAIN; encoding <= Encoding::ADAPTIVE; ++encoding)
+        {
+            for(bool nullable : {false, true})
+            {
+                unique_ptr<Column> column;
+                try {
+                    column = encoding == Encoding::ADAPTIVE ? unique_ptr<Column>(new AdaptiveColumn(type, nullable, 4096, 512))
+                                                            : makeColumn(type, static_cast<Encoding::type>(encoding), nullable);
+                } catch(invalid_argument&)
+                {
+                    continue;
+                }
+                fill(*column, type, nullable, rows, random);
+                columns.push_back(move(column));
+                names.push_back("type " + to_string(type) + " encoding " + to_string(encoding) + (nullable ? " nullable" : ""));
+            }
+        }
+    }
+
+    char first[] = "/tmp/column_test_XXXXXX";
+    char second[] = "/tmp/column_test_XXXXXX";
+    int firstFd = mkstemp(first);
+    int secondFd = mkstemp(second);
+    if (firstFd < 0 || secondFd < 0)
+    {
+        throw runtime_error("cannot create temporary file");
+    }
+    close(firstFd);
+    close(secondFd);
+
+    saveColumns(first, columns);
+    saveColumns(second, columns);
+    expect(readFile(first) == readFile(second), "column files of the same columns are identical");
+
+    vector<unique_ptr<Column>> loaded = loadColumns(first, true);
+    expect(loaded.size() == columns.size(), "column file holds every column");
+    for(uint64_t c = 0; c < columns.size() && c < loaded.size(); ++c)
+    {
+        Column& saved = *columns[c];
+        Column& read = *loaded[c];
+        IsNullable* savedNulls = dynamic_cast<IsNullable*>(&saved);
+        IsNullable* readNulls = dynamic_cast<IsNullable*>(&read);
+        bool same = read.size() == saved.size() && (savedNulls != nullptr) == (readNulls != nullptr);
+        for(uint64_t i = 0; same && i < saved.size(); ++i)
+        {
+            bool null = savedNulls != nullptr && savedNulls->getNull(i);
+            same = (readNulls != nullptr && readNulls->getNull(i)) == null && (null || viewString(read.getView(i)) == viewString(saved.getView(i)));
+        }
+        expect(same, "column file round trip of " + names[c]);
+    }
+
+    remove(first);
+    remove(second);
+}
+
+int main()
+{
+    mt19937_64 random(42);
+
+    testJoin(random);
+    testSort(random);
+    testTopK(random);
+    testGroupBy(random);
+    testLz4(random);
+    testColumnFile(random);
+
+    cout << (failures == 0 ? "all checks passed" : to_string(failures) + " checks failed") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "column.h"
+#include "bitmap.h"
+#include "filter.h"
+#include "groupby.h"
+#include "parallel.h"
+#include "sort.h"
+
+// The k best rows by keys of type U: values for numbers, ranks for dictionary strings, prefixes for
+// plain strings, whose ties tie() resolves. Workers take morsels of rows into bounded heaps of their
+// own, worst entry on top. Once a heap is full every batch is compared against the worst key with
+// the SIMD kernels of filter.h and only the rows that pass it touch the heap. Ties go to the lower
+// row, so each worker, seeing its rows in increasing order, can reject keys equal to the worst.
+template<typename U>
+class TopK
+{
+public:
+    static constexpr uint64_t batch_size = 1024;
+    static constexpr uint64_t morsel_size = 64 * 1024;
+private:
+    typedef typename U::c_type c_type;
+
+    struct Entry
+    {
+        c_type key;
+        uint64_t row;
+    };
+
+    uint64_t _k;
+    bool _descending;
+    uint32_t _workers;
+public:
+    TopK(uint64_t k, SortOrder::type order, uint32_t workers = std::thread::hardware_concurrency())
+        :_k(k), _descending(order == SortOrder::DESCENDING), _workers(workers > 0 ? workers : 1) {}
+    // read(begin, count, buffer) gives the keys of rows [begin, begin + count), tie(left, right)
+    // orders rows with equal keys when exact is false. Rows unset in validity or selection are skipped.
+    template<typename R, typename T>
+    std::vector<uint64_t> run(uint64_t rows, R read, T tie, bool exact, const uint64_t* validity, const uint64_t* selection)
+    {
+        auto better = [&](const Entry& left, const Entry& right) {
+            if (left.key != right.key)
+            {
+                return _descending ? left.key > right.key : left.key < right.key;
+            }
+            int order = exact ? 0 : tie(left.row, right.row);
+            if (order != 0)
+            {
+                return _descending ? order > 0 : order < 0;
+            }
+            return left.row < right.row;
+        };
+        CompareOp::type op = _descending ? (exact ? CompareOp::GT : CompareOp::GE) : (exact ? CompareOp::LT : CompareOp::LE);
+
+        uint32_t workers = workersFor((rows + morsel_size - 1) / morsel_size, _workers);
+        std::vector<std::vector<Entry>> heaps(workers);
+        std::atomic<uint64_t> next{0};
+        parallel(workers, [&](uint32_t w) {
+            if (_k == 0)
+            {
+                return;
+            }
+            std::vector<Entry>& heap = heaps[w];
+            heap.reserve(_k);
+            std::vector<c_type> buffer(batch_size);
+            std::vector<c_type> threshold(1);
+            uint64_t words[batch_size / 64];
+            auto offer = [&](c_type key, uint64_t row) {
+                if (key != key || !valid(validity, row) || !valid(selection, row))
+                {
+                    return;
+                }
+                Entry entry{key, row};
+                if (heap.size() < _k)
+                {
+                    heap.push_back(entry);
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+                else if (better(entry, heap.front()))
+                {
+                    std::pop_heap(heap.begin(), heap.end(), better);
+                    heap.back() = entry;
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+            };
+
+            for(uint64_t morsel = next.fetch_add(morsel_size); morsel < rows; morsel = next.fetch_add(morsel_size))
+            {
+                uint64_t end = morsel + morsel_size < rows ? morsel + morsel_size : rows;
+                for(uint64_t begin = morsel; begin < end; begin += batch_size)
+                {
+                    uint64_t count = end - begin < batch_size ? end - begin : batch_size;
+                    const c_type* keys = read(begin, count, buffer.data());
+                    uint64_t i = 0;
+                    for(; i < count && heap.size() < _k; ++i)
+                    {
+                        offer(keys[i], begin + i);
+                    }
+                    if (i == count)
+                    {
+                        continue;
+                    }
+
+                    threshold[0] = heap.front().key;
+                    filter<U>(keys + i, count - i, op, threshold, words);
+                    for(uint64_t word = 0; word < (count - i + 63) / 64; ++word)
+                    {
+                        for(uint64_t bits = words[word]; bits != 0; bits &= bits - 1)
+                        {
+                            uint64_t j = i + word * 64 + static_cast<uint64_t>(__builtin_ctzll(bits));
+                            offer(keys[j], begin + j);
+                        }
+                    }
+                }
+            }
+        });
+
+        std::vector<Entry> merged;
+        for(std::vector<Entry>& heap : heaps)
+        {
+            merged.insert(merged.end(), heap.begin(), heap.end());
+        }
+        uint64_t count = merged.size() < _k ? merged.size() : _k;
+        std::partial_sort(merged.begin(), merged.begin() + count, merged.end(), better);
+        std::vector<uint64_t> result(count);
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            result[i] = merged[i].row;
+        }
+        return result;
+    }
+private:
+    static inline bool valid(const uint64_t* bits, uint64_t row)
+    {
+        return bits == nullptr || ((bits[row / 64] >> (row % 64)) & 1) != 0;
+    }
+};
+
+template<typename U, typename C>
+inline std::vector<uint64_t> topValues(C& column, const uint64_t* validity, uint64_t k, SortOrder::type order, const Bitmap* selection, uint32_t workers)
+{
+    TopK<U> top(k, order, workers);
+    uint64_t rows = selection != nullptr && selection->size() < column.size() ? selection->size() : column.size();
+    return top.run(rows, [&](uint64_t begin, uint64_t count, typename U::c_type* buffer) {
+        return plainRows<U>(column, begin, count, buffer);
+    }, [](uint64_t, uint64_t) { return 0; }, true, validity, selection != nullptr ? selection->words() : nullptr);
+}
+
+template<typename C>
+inline std::vector<uint64_t> topCodes(C& column, const uint64_t* validity, uint64_t k, SortOrder::type order, const Bitmap* selection, uint32_t workers)
+{
+    TypeStore<DictStore>& dictionary = column.dictionary();
+    std::vector<uint32_t> ranks = dictionaryRanks(dictionary);
+    TopK<UInt32Type> top(k, order, workers);
+    uint64_t rows = selection != nullptr && selection->size() < dictionary.size() ? selection->size() : dictionary.size();
+    return top.run(rows, [&](uint64_t begin, uint64_t count, uint32_t* buffer) {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            buffer[i] = ranks[dictionary.code(begin + i)];
+        }
+        return static_cast<const uint32_t*>(buffer);
+    }, [](uint64_t, uint64_t) { return 0; }, true, validity, selection != nullptr ? selection->words() : nullptr);
+}
+
+template<typename C>
+inline std::vector<uint64_t> topStrings(C& column, const uint64_t* validity, uint64_t k, SortOrder::type order, const Bitmap* selection, uint32_t workers)
+{
+    TopK<UInt64Type> top(k, order, workers);
+    uint64_t rows = selection != nullptr && selection->size() < column.size() ? selection->size() : column.size();
+    return top.run(rows, [&](uint64_t begin, uint64_t count, uint64_t* buffer) {
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            buffer[i] = prefixKey(column.getView(begin + i));
+        }
+        return static_cast<const uint64_t*>(buffer);
+    }, [&](uint64_t left, uint64_t right) {
+        return compareBytes(column.getView(left), column.getView(right));
+    }, false, validity, selection != nullptr ? selection->words() : nullptr);
+}
+
+// Rows of the k largest values (DESCENDING) or the k smallest (ASCENDING), best first, skipping
+// nulls, NaNs and rows outside selection when one is given. Ties go to the lower row.
+template<typename U>
+inline std::vector<uint64_t> topK(TypedColumn<PlainStore, U>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topValues<U>(column, nullptr, k, order, selection, workers);
+}
+
+template<typename U>
+inline std::vector<uint64_t> topK(NullableTypedColumn<PlainStore, U>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topValues<U>(column, column.validity().words(), k, order, selection, workers);
+}
+
+inline std::vector<uint64_t> topK(TypedColumn<DictStore, StringType>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topCodes(column, nullptr, k, order, selection, workers);
+}
+
+inline std::vector<uint64_t> topK(NullableTypedColumn<DictStore, StringType>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topCodes(column, column.validity().words(), k, order, selection, workers);
+}
+
+inline std::vector<uint64_t> topK(TypedColumn<PlainStore, StringType>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topStrings(column, nullptr, k, order, selection, workers);
+}
+
+inline std::vector<uint64_t> topK(NullableTypedColumn<PlainStore, StringType>& column, uint64_t k, SortOrder::type order = SortOrder::DESCENDING,
+                                  const Bitmap* selection = nullptr, uint32_t workers = std::thread::hardware_concurrency())
+{
+    return topStrings(column, column.validity().words(), k, order, selection, workers);
+}
+
+#endif // TOPK_H
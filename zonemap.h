@@ -0,0 +1,209 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <cmath>
+#include <limits>
+#include <memory.h>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "array.h"
+#include "hash.h"
+
+// Statistics of one row group. min and max cover the non-NaN values; rows counts the non-null
+// values and nulls the null rows.
+template<typename T>
+struct Zone
+{
+    typedef typename T::c_type c_type;
+
+    c_type min;
+    c_type max;
+    uint64_t rows;
+    uint64_t nulls;
+    uint64_t distinct;
+};
+
+// HyperLogLog with 256 one-byte registers, about 6.5% standard error.
+class DistinctSketch
+{
+private:
+    static constexpr uint64_t registers = 256;
+
+    uint8_t _registers[registers];
+public:
+    DistinctSketch()
+    {
+        clear();
+    }
+    inline void clear()
+    {
+        memset(_registers, 0, sizeof(_registers));
+    }
+    inline void add(uint64_t hash)
+    {
+        uint64_t index = hash >> 56;
+        uint64_t rest = hash << 8;
+        uint8_t rank = rest == 0 ? 57 : static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        _registers[index] = rank > _registers[index] ? rank : _registers[index];
+    }
+    inline uint64_t estimate() const
+    {
+        double sum = 0;
+        uint64_t zeros = 0;
+        for(uint64_t i = 0; i < registers; ++i)
+        {
+            sum += std::ldexp(1.0, -static_cast<int>(_registers[i]));
+            zeros += _registers[i] == 0;
+        }
+
+        double m = static_cast<double>(registers);
+        double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        if (estimate <= 2.5 * m && zeros > 0)
+        {
+            estimate = m * std::log(m / static_cast<double>(zeros));
+        }
+        return static_cast<uint64_t>(estimate + 0.5);
+    }
+};
+
+// Per row group statistics maintained as values are appended. Groups are a power of two of at
+// least 64 rows, so group boundaries fall on selection bitmap words.
+template<typename T>
+class ZoneMap
+{
+public:
+    static constexpr uint64_t default_group_size = 64 * 1024;
+private:
+    typedef typename T::c_type c_type;
+
+    uint64_t _groupSize;
+    uint64_t _shift;
+    uint64_t _rows = 0;
+    MappableVector<Zone<T>> _zones;
+    DistinctSketch _sketch;
+    uint64_t _sketchGroup = 0;
+public:
+    explicit ZoneMap(uint64_t groupSize = default_group_size)
+    {
+        setGroupSize(groupSize);
+    }
+    inline void add(c_type value)
+    {
+        Zone<T>& zone = open(_rows >> _shift);
+        zone.min = value < zone.min ? value : zone.min;
+        zone.max = value > zone.max ? value : zone.max;
+        zone.rows++;
+        _sketch.add(hash(value));
+        _rows++;
+    }
+    inline void add(const c_type* data, uint64_t count)
+    {
+        while(count > 0)
+        {
+            Zone<T>& zone = open(_rows >> _shift);
+            uint64_t room = _groupSize - (_rows & (_groupSize - 1));
+            uint64_t rows = count < room ? count : room;
+
+            c_type low = zone.min;
+            c_type high = zone.max;
+            for(uint64_t i = 0; i < rows; ++i)
+            {
+                low = data[i] < low ? data[i] : low;
+                high = data[i] > high ? data[i] : high;
+            }
+            for(uint64_t i = 0; i < rows; ++i)
+            {
+                _sketch.add(hash(data[i]));
+            }
+            zone.min = low;
+            zone.max = high;
+            zone.rows += rows;
+
+            _rows += rows;
+            data += rows;
+            count -= rows;
+        }
+    }
+    // A null row takes its position in the group but not part in min, max or distinct.
+    inline void addNull()
+    {
+        open(_rows >> _shift).nulls++;
+        _rows++;
+    }
+    inline uint64_t groupSize() const
+    {
+        return _groupSize;
+    }
+    inline uint64_t groupCount() const
+    {
+        return _zones.size();
+    }
+    inline Zone<T> zone(uint64_t group) const
+    {
+        Zone<T> zone = _zones.at(group);
+        if (group == _sketchGroup && !_zones.mapped())
+        {
+            zone.distinct = _sketch.estimate();
+        }
+        return zone;
+    }
+    // All groups with the open group's distinct estimate brought up to date, e.g. for saving.
+    inline const MappableVector<Zone<T>>& zones()
+    {
+        if (_sketchGroup < _zones.size() && !_zones.mapped())
+        {
+            _zones[_sketchGroup].distinct = _sketch.estimate();
+        }
+        return _zones;
+    }
+    inline void map(uint64_t groupSize, const Zone<T>* zones, uint64_t count)
+    {
+        setGroupSize(groupSize);
+        _zones.map(zones, count);
+    }
+    inline uint64_t overhead() const
+    {
+        return _zones.capacity() * sizeof(Zone<T>) + sizeof(DistinctSketch);
+    }
+private:
+    inline void setGroupSize(uint64_t groupSize)
+    {
+        if (groupSize < 64 || (groupSize & (groupSize - 1)) != 0)
+        {
+            throw std::invalid_argument("row group size must be a power of two of at least 64");
+        }
+        _groupSize = groupSize;
+        _shift = 0;
+        while((uint64_t(1) << _shift) < groupSize)
+        {
+            _shift++;
+        }
+    }
+    inline Zone<T>& open(uint64_t group)
+    {
+        if (group >= _zones.size())
+        {
+            _zones.resize(group + 1, empty());
+        }
+        if (group != _sketchGroup)
+        {
+            _zones[_sketchGroup].distinct = _sketch.estimate();
+            _sketch.clear();
+            _sketchGroup = group;
+        }
+        return _zones[group];
+    }
+    static inline Zone<T> empty()
+    {
+        return Zone<T>{std::numeric_limits<c_type>::max(), std::numeric_limits<c_type>::lowest(), 0, 0, 0};
+    }
+    static inline uint64_t hash(c_type value)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(value));
+        return hashMix(bits ^ 0x9e3779b97f4a7c15ULL);
+    }
+};
+
+#endif // ZONEMAP_H